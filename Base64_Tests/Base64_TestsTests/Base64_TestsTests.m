@@ -11,7 +11,12 @@
 #import "../../NSData+MIGBase64.h"
 #import "../../NSString+MIGBase64.h"
 #import "../../MIGBase64.h"
+#import "../../MIGBase64Cache.h"
 #import "../../MIGConverter.h"
+#import "../../MIGPipeline.h"
+#import "../../MIGBase64_Common.h"
+
+#include <fcntl.h>
 
 /** RFC Test vectors
  10.  Test Vectors
@@ -135,6 +140,97 @@
     
 }
 
+- (void)testLenientDecodeSeparators
+{
+    NSError *error;
+    
+    NSString *expected = @"Man is distinguished, not only by his reason, but by this singular passion from other animals, which is a lust of the mind, that by a perseverance of delight in the continued and indefatigable generation of knowledge, exceeds the short vehemence of any carnal pleasure.";
+    
+    // LF only, varying line lengths
+    NSString *b64Test =
+        @"TWFuIGlzIGRpc3Rpbmd1aXNoZWQsIG5vdCBvbmx5IGJ5IGhp\n"
+        @"cyByZWFzb24sIGJ1dCBieSB0aGlzIHNpbmd1bGFyIHBhc3Npb24gZnJvbSBvdGhlciBhbmltYWxzLCB3aGljaCBp\n"
+        @"cyBhIGx1c3Qgb2YgdGhlIG1p\n"
+        @"bmQsIHRoYXQgYnkgYSBwZXJzZXZlcmFuY2Ugb2YgZGVsaWdodCBpbiB0aGUgY29udGludWVkIGFuZCBpbmRlZmF0aWdhYmxlIGdlbmVyYXRpb24gb2Yga25vd2xlZGdlLCBleGNlZWRzIHRo\n"
+        @"ZSBzaG9ydCB2ZWhlbWVuY2Ugb2YgYW55IGNhcm5hbCBwbGVhc3VyZS4=\n";
+    NSString *result = [b64Test decodeBase64AsString:&error];
+    STAssertEqualObjects(expected, result, @"Decoding LF wrapped example");
+    
+    // Mixed whitespace
+    b64Test =
+        @"  TWFuIGlzIGRpc3Rpbmd1aXNoZWQsIG5vdCBvbmx5IGJ5IGhpcyByZWFzb24sIGJ1dCBieSB0aGlz\r\n"
+        @"\tIHNpbmd1bGFyIHBhc3Npb24gZnJvbSBvdGhlciBhbmltYWxzLCB3aGljaCBpcyBhIGx1c3Qgb2Yg \n"
+        @"dGhlIG1pbmQsIHRoYXQg YnkgYSBwZXJzZXZlcmFuY2Ugb2YgZGVsaWdodCBpbiB0aGUgY29udGlu\r\n\r\n"
+        @"dWVkIGFuZCBpbmRlZmF0aWdhYmxlIGdlbmVyYXRpb24gb2Yga25vd2xlZGdlLCBleGNlZWRzIHRo\t\t"
+        @"ZSBzaG9ydCB2ZWhlbWVuY2Ugb2YgYW55IGNhcm5hbCBwbGVhc3VyZS4=  ";
+    result = [b64Test decodeBase64AsString:&error];
+    STAssertEqualObjects(expected, result, @"Decoding whitespace laden example");
+    
+    // JSON-escaped '/'
+    NSString *encoding =
+        @"iVBORw0KGgoAAAANSUhEUgAAACAAAAATBAMAAAADuhLEAAAABGdBTUEAALGP"
+        @"C\\/xhBQAAAAFzUkdCAdnJLH8AAAAPUExURYSEhP\\/\\/\\/wAAAP\\/\\/AP8AACykMFsA"
+        @"AABsSURBVHjahdDBDcMwDENRWhsw9AJRuwCBLuAi+8+UQ+rGTg75NwkPECBg"
+        @"LlDmAuBUoCyZfapbm4Tr1gJlybVvPt\\/XKMz6boHyX4iWBmGKdBf5i6cwSVpX"
+        @"4fGKnoRpqQsdV+1TmLYkBW4Pyks7gc8WIpISYokAAAAASUVORK5CYII=";
+    
+    NSString *path = [[NSBundle bundleForClass:[self class]] pathForResource:@"mail" ofType:@"png"];
+    NSData *image = [NSData dataWithContentsOfFile:path];
+    
+    NSData *decoded = [encoding decodeBase64AsData:&error];
+    STAssertEqualObjects(image, decoded, @"Decoding JSON escaped image data");
+}
+
+- (void)testStrictDecode
+{
+    NSError *error = nil;
+    
+    NSData *vector = [@"Zm9v\r\nYmFy" dataUsingEncoding:NSASCIIStringEncoding];
+    NSData *result = [vector decodeFromBase64DataStrict:&error];
+    STAssertEqualObjects([@"foobar" dataUsingEncoding:NSASCIIStringEncoding], result, @"Strict decoding with line separators");
+    
+    vector = [@"Zm9v Yg==" dataUsingEncoding:NSASCIIStringEncoding];
+    result = [vector decodeFromBase64DataStrict:&error];
+    STAssertNil(result, @"Strict decoding rejects whitespace");
+    STAssertEquals((NSInteger)MIG_Base64IllegalCharacter, error.code, @"Illegal character reason");
+    STAssertEqualObjects([NSNumber numberWithUnsignedInt:4], [error.userInfo objectForKey:kB64ErrorOffsetKey], @"Illegal character offset");
+    
+    vector = [@"Zg==Zg==" dataUsingEncoding:NSASCIIStringEncoding];
+    result = [vector decodeFromBase64DataStrict:&error];
+    STAssertNil(result, @"Strict decoding rejects data after padding");
+    STAssertEquals((NSInteger)MIG_Base64PaddingInvalid, error.code, @"Misplaced padding reason");
+    STAssertEqualObjects([NSNumber numberWithUnsignedInt:4], [error.userInfo objectForKey:kB64ErrorOffsetKey], @"Misplaced padding offset");
+    
+    vector = [@"Zm9vY" dataUsingEncoding:NSASCIIStringEncoding];
+    result = [vector decodeFromBase64DataStrict:&error];
+    STAssertNil(result, @"Strict decoding rejects a partial quantum");
+    STAssertEquals((NSInteger)MIG_Base64Truncated, error.code, @"Truncated reason");
+    STAssertEqualObjects([NSNumber numberWithUnsignedInt:5], [error.userInfo objectForKey:kB64ErrorOffsetKey], @"Truncated offset");
+}
+
+- (void)testExcessPadding
+{
+    NSError *error = nil;
+    unsigned char *result = NULL;
+    unsigned int result_len = 0;
+    
+    // More '=' than data used to wrap the decoded length to ~4GB
+    const char *vectors[] = { "========", "A=======", "AA==AA==" };
+    for (int i = 0; i < 3; i++)
+    {
+        STAssertEquals(MIG_Base64EncodingInvalid, MIG_decodedLength(vectors[i], (unsigned int)strlen(vectors[i]), &result_len), @"Excess padding length");
+        STAssertEquals(MIG_Base64EncodingInvalid, MIG_decodeAsBase64(vectors[i], (unsigned int)strlen(vectors[i]), &result, &result_len), @"Excess padding decode");
+    }
+    
+    NSData *vector = [@"========" dataUsingEncoding:NSASCIIStringEncoding];
+    STAssertNil([vector decodeFromBase64Data:&error], @"Excess padding category decode");
+    STAssertEquals((NSInteger)MIG_Base64EncodingInvalid, error.code, @"Excess padding reason");
+    
+    NSMutableData *buffer = [NSMutableData dataWithBytes:"Parts:" length:6];
+    STAssertFalse([NSData appendBase64DecodingOfChars:"A=======" length:8 toData:buffer error:&error], @"Excess padding append");
+    STAssertEquals((NSUInteger)6, buffer.length, @"Excess padding leaves the buffer untouched");
+}
+
 - (void)testSimpleImage
 {
     NSError *error;
@@ -153,6 +249,336 @@
     STAssertEqualObjects(image, decoded, @"Decoding basic image data");
 }
 
+- (void)testAppendToMutableData
+{
+    NSError *error;
+    NSString *path = [[NSBundle bundleForClass:[self class]] pathForResource:@"mail" ofType:@"png"];
+    NSData *image = [NSData dataWithContentsOfFile:path];
+    
+    NSMutableData *message = [NSMutableData dataWithBytes:"Parts:" length:6];
+    BOOL ok = [NSData appendBase64EncodingOfBytes:"foobar" length:6 formatting:NO toData:message error:&error];
+    STAssertTrue(ok, @"Append encoding of bytes");
+    ok = [NSData appendBase64EncodingOfData:image formatting:YES toData:message error:&error];
+    STAssertTrue(ok, @"Append encoding of data");
+    
+    NSMutableData *expected = [NSMutableData dataWithBytes:"Parts:Zm9vYmFy" length:14];
+    [expected appendData:[image encodeAsBase64DataUsingLineEndings:YES error:&error]];
+    STAssertEqualObjects(expected, message, @"Appended encodings");
+    
+    // And decode the parts back onto the end of a reused buffer
+    NSMutableData *decoded = [NSMutableData dataWithBytes:"Parts:" length:6];
+    ok = [NSData appendBase64DecodingOfChars:(const char *)message.bytes + 6 length:8 toData:decoded error:&error];
+    STAssertTrue(ok, @"Append decoding of chars");
+    NSData *encodedImage = [message subdataWithRange:NSMakeRange(14, message.length - 14)];
+    ok = [NSData appendBase64DecodingOfData:encodedImage toData:decoded error:&error];
+    STAssertTrue(ok, @"Append decoding of data");
+    
+    expected = [NSMutableData dataWithBytes:"Parts:foobar" length:12];
+    [expected appendData:image];
+    STAssertEqualObjects(expected, decoded, @"Appended decodings");
+    
+    // Empty parts append nothing, even when their bytes are NULL
+    NSUInteger length = decoded.length;
+    ok = [NSData appendBase64EncodingOfData:[NSData data] formatting:NO toData:decoded error:&error];
+    STAssertTrue(ok, @"Append encoding of empty data");
+    ok = [NSData appendBase64EncodingOfBytes:NULL length:0 formatting:YES toData:decoded error:&error];
+    STAssertTrue(ok, @"Append encoding of no bytes");
+    ok = [NSData appendBase64DecodingOfData:[NSData data] toData:decoded error:&error];
+    STAssertTrue(ok, @"Append decoding of empty data");
+    ok = [NSData appendBase64DecodingOfChars:NULL length:0 toData:decoded error:&error];
+    STAssertTrue(ok, @"Append decoding of no chars");
+    STAssertEquals(length, decoded.length, @"Empty appends leave the buffer untouched");
+    
+    // Failures leave the buffer untouched
+    ok = [NSData appendBase64DecodingOfChars:"Zm9vY" length:5 toData:decoded error:&error];
+    STAssertFalse(ok, @"Append decoding of invalid base64");
+    STAssertEquals(length, decoded.length, @"Failed append leaves the buffer untouched");
+}
+
+- (void)testSegmentedConversion
+{
+    NSString *path = [[NSBundle bundleForClass:[self class]] pathForResource:@"mail" ofType:@"png"];
+    NSData *image = [NSData dataWithContentsOfFile:path];
+    const unsigned char *bytes = image.bytes;
+    
+    char *expected;
+    unsigned int expected_len;
+    MIG_Result res = MIG_encodeAsBase64(1, bytes, image.length, &expected, &expected_len);
+    STAssertEquals(MIG_OK, res, @"Contiguous encoding");
+    
+    // Input segments splitting quanta, output segments splitting quanta and line separators
+    struct iovec in[4] = { { (void *)bytes, 1 }, { (void *)(bytes + 1), 5 }, { (void *)(bytes + 6), 0 },
+                           { (void *)(bytes + 6), image.length - 6 } };
+    char encoded[512];
+    struct iovec out[3] = { { encoded, 78 }, { encoded + 78, 3 }, { encoded + 81, sizeof(encoded) - 81 } };
+    MIG_SegmentPosition consumed, filled;
+    
+    res = MIG_encodeAsBase64Segments(1, in, 4, out, 3, &consumed, &filled);
+    STAssertEquals(MIG_OK, res, @"Segmented encoding");
+    STAssertEquals((size_t)image.length, consumed.total, @"Segmented encoding consumed");
+    STAssertEquals((size_t)expected_len, filled.total, @"Segmented encoding filled");
+    STAssertEquals(2U, filled.segment, @"Segmented encoding last segment");
+    STAssertEquals((size_t)(expected_len - 81), filled.offset, @"Segmented encoding last segment offset");
+    STAssertTrue(memcmp(encoded, expected, expected_len) == 0, @"Segmented encoding result");
+    
+    // A fixed size output buffer, filled a line at a time, resuming from where the last call stopped
+    char line[100];
+    struct iovec lineOut[1] = { { line, sizeof(line) } };
+    struct iovec rest[4];
+    unsigned int restCnt = 4;
+    size_t total = 0;
+    memcpy(rest, in, sizeof(in));
+    do
+    {
+        res = MIG_encodeAsBase64Segments(1, rest, restCnt, lineOut, 1, &consumed, &filled);
+        STAssertTrue(memcmp(line, expected + total, filled.total) == 0, @"Resumed encoding part");
+        total += filled.total;
+        
+        restCnt -= consumed.segment;
+        memmove(rest, rest + consumed.segment, restCnt * sizeof(struct iovec));
+        if (restCnt > 0)
+        {
+            rest[0].iov_base = (char *)rest[0].iov_base + consumed.offset;
+            rest[0].iov_len -= consumed.offset;
+        }
+    } while (res == MIG_OutputTooSmall && filled.total > 0);
+    STAssertEquals(MIG_OK, res, @"Resumed encoding");
+    STAssertEquals((size_t)expected_len, total, @"Resumed encoding length");
+    
+    // And back again
+    struct iovec encIn[3] = { { expected, 2 }, { expected + 2, 77 }, { expected + 79, expected_len - 79 } };
+    unsigned char decoded[512];
+    struct iovec decOut[2] = { { decoded, 7 }, { decoded + 7, sizeof(decoded) - 7 } };
+    
+    res = MIG_decodeAsBase64Segments(encIn, 3, decOut, 2, &consumed, &filled);
+    STAssertEquals(MIG_OK, res, @"Segmented decoding");
+    STAssertEquals((size_t)image.length, filled.total, @"Segmented decoding filled");
+    STAssertEqualObjects(image, [NSData dataWithBytes:decoded length:filled.total], @"Segmented decoding result");
+    
+    struct iovec shortOut[1] = { { decoded, 100 } };
+    res = MIG_decodeAsBase64Segments(encIn, 3, shortOut, 1, &consumed, &filled);
+    STAssertEquals(MIG_OutputTooSmall, res, @"Segmented decoding with insufficient output");
+    STAssertEquals((size_t)99, filled.total, @"Segmented decoding stops on a quantum");
+    STAssertEquals((size_t)134, consumed.total, @"Segmented decoding consumed");
+    STAssertEquals(2U, consumed.segment, @"Segmented decoding consumed segment");
+    STAssertEquals((size_t)55, consumed.offset, @"Segmented decoding consumed offset");
+    
+    // Draining the input through a fixed size buffer, validating it only once
+    MIG_SegmentDecodeState state = { 0, 0 };
+    unsigned char block[30];
+    struct iovec blockOut[1] = { { block, sizeof(block) } };
+    NSMutableData *drained = [NSMutableData data];
+    memcpy(rest, encIn, sizeof(encIn));
+    restCnt = 3;
+    do
+    {
+        res = MIG_decodeAsBase64SegmentsResumable(rest, restCnt, blockOut, 1, &state, &consumed, &filled);
+        [drained appendBytes:block length:filled.total];
+        
+        restCnt -= consumed.segment;
+        memmove(rest, rest + consumed.segment, restCnt * sizeof(struct iovec));
+        if (restCnt > 0)
+        {
+            rest[0].iov_base = (char *)rest[0].iov_base + consumed.offset;
+            rest[0].iov_len -= consumed.offset;
+        }
+    } while (res == MIG_OutputTooSmall && filled.total > 0);
+    STAssertEquals(MIG_OK, res, @"Resumed decoding");
+    STAssertEqualObjects(image, drained, @"Resumed decoding result");
+    
+    if (sizeof(size_t) > 4)
+    {
+        // Segments too long for the 32 bit character counts are rejected without being read
+        struct iovec hugeIn[1] = { { expected, (size_t)UINT_MAX + 1 } };
+        res = MIG_decodeAsBase64Segments(hugeIn, 1, decOut, 2, &consumed, &filled);
+        STAssertEquals(MIG_InputTooLarge, res, @"Segmented decoding of a 4GB segment");
+    }
+    
+    struct iovec padIn[2] = { { "A===", 4 }, { "====", 4 } };
+    res = MIG_decodeAsBase64Segments(padIn, 2, decOut, 2, &consumed, &filled);
+    STAssertEquals(MIG_Base64EncodingInvalid, res, @"Segmented decoding of excess padding");
+    
+    free(expected);
+}
+
+- (void)testPipeline
+{
+    NSString *path = [[NSBundle bundleForClass:[self class]] pathForResource:@"mail" ofType:@"png"];
+    NSData *image = [NSData dataWithContentsOfFile:path];
+    
+    // Enough copies of the image to span plenty of (small) blocks
+    NSMutableData *payload = [NSMutableData data];
+    for (int i = 0; i < 200; i++)
+    {
+        [payload appendData:image];
+    }
+    
+    NSString *dir = NSTemporaryDirectory();
+    NSString *rawPath = [dir stringByAppendingPathComponent:@"MIGPipelineTest.bin"];
+    NSString *encPath = [dir stringByAppendingPathComponent:@"MIGPipelineTest.b64"];
+    NSString *decPath = [dir stringByAppendingPathComponent:@"MIGPipelineTest.out"];
+    [payload writeToFile:rawPath atomically:NO];
+    
+    char *expected;
+    unsigned int expected_len;
+    STAssertEquals(MIG_OK, MIG_encodeAsBase64(1, payload.bytes, payload.length, &expected, &expected_len), @"Contiguous encoding");
+    
+    MIG_PipelineOptions options;
+    MIG_pipelineDefaultOptions(&options);
+    options.useOptionalLineEndings = 1;
+    options.bufferSize = 1000;
+    options.workerCount = 3;
+    
+    MIG_PipelineStats stats;
+    int in_fd = open([rawPath fileSystemRepresentation], O_RDONLY);
+    int out_fd = open([encPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    MIG_Result res = MIG_pipeline(in_fd, out_fd, &options, &stats);
+    close(in_fd);
+    close(out_fd);
+    
+    STAssertEquals(MIG_OK, res, @"Pipeline encoding");
+    STAssertEquals((unsigned long long)payload.length, stats.bytesRead, @"Pipeline encoding bytes read");
+    STAssertEquals((unsigned long long)expected_len, stats.bytesWritten, @"Pipeline encoding bytes written");
+    STAssertTrue(stats.blocks > 1 && stats.throughput > 0, @"Pipeline encoding statistics");
+    STAssertEqualObjects([NSData dataWithBytes:expected length:expected_len], [NSData dataWithContentsOfFile:encPath],
+                         @"Pipeline encoding matches the contiguous encoding");
+    free(expected);
+    
+    // And back again, with both decoders
+    MIG_PipelineMode modes[2] = { MIG_PipelineDecode, MIG_PipelineDecodeFast };
+    for (int i = 0; i < 2; i++)
+    {
+        options.mode = modes[i];
+        in_fd = open([encPath fileSystemRepresentation], O_RDONLY);
+        out_fd = open([decPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        res = MIG_pipeline(in_fd, out_fd, &options, NULL);
+        close(in_fd);
+        close(out_fd);
+        
+        STAssertEquals(MIG_OK, res, @"Pipeline decoding (mode %d)", modes[i]);
+        STAssertEqualObjects(payload, [NSData dataWithContentsOfFile:decPath], @"Pipeline decoding result (mode %d)", modes[i]);
+    }
+    
+    // Padding part way through the stream, spanning many blocks, decodes as a single call does
+    NSMutableData *padded = [NSMutableData data];
+    for (int i = 0; i < 100; i++)
+    {
+        [padded appendBytes:"Zg==Zm8=\n" length:9];
+    }
+    [padded appendBytes:"QQ==\nAAAA\n" length:10];
+    [padded writeToFile:encPath atomically:NO];
+    
+    unsigned char *oneShot;
+    unsigned int oneShot_len;
+    STAssertEquals(MIG_OK, MIG_decodeAsBase64(padded.bytes, padded.length, &oneShot, &oneShot_len), @"Contiguous decoding");
+    
+    options.mode = MIG_PipelineDecode;
+    options.bufferSize = 128;
+    in_fd = open([encPath fileSystemRepresentation], O_RDONLY);
+    out_fd = open([decPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    res = MIG_pipeline(in_fd, out_fd, &options, NULL);
+    close(in_fd);
+    close(out_fd);
+    
+    STAssertEquals(MIG_OK, res, @"Pipeline decoding of padding part way through");
+    STAssertEqualObjects([NSData dataWithBytes:oneShot length:oneShot_len], [NSData dataWithContentsOfFile:decPath],
+                         @"Pipeline decoding of padding part way through matches the contiguous decoding");
+    free(oneShot);
+    
+    // Excess padding at the end of the stream is rejected, as in a single call
+    [padded appendBytes:"A===" length:4];
+    [padded writeToFile:encPath atomically:NO];
+    in_fd = open([encPath fileSystemRepresentation], O_RDONLY);
+    out_fd = open([decPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    res = MIG_pipeline(in_fd, out_fd, &options, NULL);
+    close(in_fd);
+    close(out_fd);
+    STAssertEquals(MIG_Base64EncodingInvalid, res, @"Pipeline decoding of excess padding");
+    
+    // Read failures are reported
+    res = MIG_pipeline(-1, -1, NULL, &stats);
+    STAssertEquals(MIG_IOError, res, @"Pipeline with a bad descriptor");
+    STAssertEquals(EBADF, stats.error, @"Pipeline error code");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:rawPath error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:encPath error:nil];
+    [[NSFileManager defaultManager] removeItemAtPath:decPath error:nil];
+}
+
+- (void)testResultCache
+{
+    NSError *error;
+    NSString *path = [[NSBundle bundleForClass:[self class]] pathForResource:@"mail" ofType:@"png"];
+    NSData *image = [NSData dataWithContentsOfFile:path];
+    NSString *expected = [image encodeAsBase64StringUsingLineEndings:YES error:&error];
+    
+    MIGBase64Cache *cache = [[MIGBase64Cache alloc] init];
+    cache.countLimit = 2;
+    
+    STAssertFalse([cache shouldCacheLength:image.length], @"Cache disabled by default");
+    cache.enabled = YES;
+    STAssertTrue([cache shouldCacheLength:image.length], @"Cache enabled");
+    
+    STAssertNil([cache encodedStringForData:image formatting:YES], @"Empty cache");
+    [cache setEncodedString:expected forData:image formatting:YES];
+    
+    // A copy of the payload hits, and gets the same shared result back
+    NSData *copy = [NSData dataWithBytes:image.bytes length:image.length];
+    STAssertTrue([cache encodedStringForData:copy formatting:YES] == expected, @"Shared cached result");
+    STAssertEqualObjects([expected dataUsingEncoding:NSASCIIStringEncoding], [cache encodedDataForData:copy formatting:YES], @"Cached data result");
+    STAssertNil([cache encodedStringForData:image formatting:NO], @"Formatting is part of the key");
+    STAssertEquals(2U, (unsigned int)cache.hitCount, @"Cache hits");
+    STAssertEquals(2U, (unsigned int)cache.missCount, @"Cache misses");
+    STAssertEquals((NSUInteger)(image.length + 2 * expected.length), cache.size, @"Both representations are counted");
+    
+    // Making the other representation on a hit is held to the size limit too
+    MIGBase64Cache *small = [[MIGBase64Cache alloc] init];
+    small.enabled = YES;
+    small.sizeLimit = image.length + expected.length;
+    [small setEncodedString:expected forData:image formatting:YES];
+    STAssertEquals(1U, (unsigned int)small.count, @"Within the size limit");
+    STAssertNotNil([small encodedDataForData:image formatting:YES], @"Hit beyond the size limit");
+    STAssertEquals(0U, (unsigned int)small.count, @"Evicted beyond the size limit");
+    STAssertEquals(0U, (unsigned int)small.size, @"Evicted beyond the size limit bytes");
+    
+    // Least recently used results are evicted
+    [cache setEncodedString:@"Zg==" forData:[@"f" dataUsingEncoding:NSASCIIStringEncoding] formatting:NO];
+    [cache setEncodedString:@"Zm8=" forData:[@"fo" dataUsingEncoding:NSASCIIStringEncoding] formatting:NO];
+    STAssertEquals(2U, (unsigned int)cache.count, @"Cache count limit");
+    STAssertNil([cache encodedStringForData:image formatting:YES], @"Evicted result");
+    STAssertEqualObjects(@"Zm8=", [cache encodedStringForData:[@"fo" dataUsingEncoding:NSASCIIStringEncoding] formatting:NO], @"Retained result");
+    
+    // Lowering a limit trims the cache straight away
+    cache.countLimit = 1;
+    STAssertEquals(1U, (unsigned int)cache.count, @"Lowered count limit");
+    STAssertEqualObjects(@"Zm8=", [cache encodedStringForData:[@"fo" dataUsingEncoding:NSASCIIStringEncoding] formatting:NO], @"Most recently used result kept");
+    cache.sizeLimit = 4;
+    STAssertEquals(0U, (unsigned int)cache.count, @"Lowered size limit");
+    STAssertEquals(0U, (unsigned int)cache.size, @"Lowered size limit bytes");
+    
+    // Empty payloads (whose bytes may be NULL) hash and hit like any other
+    [cache setEncodedString:@"" forData:[NSData data] formatting:NO];
+    STAssertEqualObjects(@"", [cache encodedStringForData:[NSData data] formatting:NO], @"Empty payload");
+    
+    // Size thresholds
+    cache.minimumLength = 64;
+    STAssertFalse([cache shouldCacheLength:2], @"Below minimum length");
+    cache.maximumLength = 128;
+    STAssertFalse([cache shouldCacheLength:image.length], @"Above maximum length");
+    
+    // The shared cache is consulted by the NSData encoders
+    MIGBase64Cache *shared = [MIGBase64Cache sharedCache];
+    shared.enabled = YES;
+    [shared resetStatistics];
+    NSString *first = [image encodeAsBase64StringUsingLineEndings:YES error:&error];
+    NSString *second = [image encodeAsBase64StringUsingLineEndings:YES error:&error];
+    STAssertEqualObjects(expected, first, @"Shared cache first encode");
+    STAssertTrue(first == second, @"Shared cache second encode");
+    STAssertEquals(1U, (unsigned int)shared.hitCount, @"Shared cache hits");
+    shared.enabled = NO;
+    [shared removeAllObjects];
+}
+
 - (void)testBase64Class
 {
     NSString *testPhrase = @"Testing class encoding";
@@ -190,6 +616,54 @@
     STAssertEqualObjects(image, decoded, @"Basic set Base64 archive/unarchive");
 }
 
+- (void)testBase64RawStorage
+{
+    NSError *error;
+    NSString *path = [[NSBundle bundleForClass:[self class]] pathForResource:@"mail" ofType:@"png"];
+    NSData *image = [NSData dataWithContentsOfFile:path];
+    
+    // Memory mapped, with the encoding made on demand
+    MIGBase64 *raw = [MIGBase64 createWithContentsOfFile:path useFormatting:YES error:&error];
+    STAssertNotNil(raw, @"Create from file");
+    STAssertTrue(raw.storesRawData, @"Created from file stores raw data");
+    STAssertEqualObjects(image, raw.data, @"Raw data");
+    
+    // Describing the object doesn't encode it
+    STAssertTrue([raw.description rangeOfString:@"not yet encoded"].location != NSNotFound, @"Raw description");
+    STAssertTrue([raw.description rangeOfString:@"not yet encoded"].location != NSNotFound, @"Raw description is side effect free");
+    STAssertEqualObjects([image encodeAsBase64DataUsingLineEndings:YES error:&error], raw.base64, @"Lazy encoding");
+    
+    raw.useFormatting = NO;
+    STAssertEqualObjects([image encodeAsBase64DataUsingLineEndings:NO error:&error], raw.base64, @"Lazy encoding after formatting change");
+    
+    // Archives hold the raw bytes, so are smaller than those holding the encoding
+    MIGBase64 *encoded = [MIGBase64 createWithData:image useFormatting:NO];
+    NSData *rawArchive = [NSKeyedArchiver archivedDataWithRootObject:raw];
+    NSData *encodedArchive = [NSKeyedArchiver archivedDataWithRootObject:encoded];
+    STAssertTrue(rawArchive.length < encodedArchive.length, @"Raw archive is smaller");
+    
+    MIGBase64 *decObj = [NSKeyedUnarchiver unarchiveObjectWithData:rawArchive];
+    STAssertTrue(decObj.storesRawData, @"Unarchived object stores raw data");
+    STAssertEqualObjects(image, decObj.data, @"Raw archive/unarchive");
+    STAssertEqualObjects(encoded.base64, decObj.base64, @"Raw archive/unarchive encoding");
+    
+    // Archives holding the encoding (as made before raw storage) still unarchive
+    decObj = [NSKeyedUnarchiver unarchiveObjectWithData:encodedArchive];
+    STAssertFalse(decObj.storesRawData, @"Encoded archive stores the encoding");
+    STAssertEqualObjects(image, decObj.data, @"Encoded archive/unarchive");
+    
+    // Switching storage keeps the content
+    decObj.storesRawData = YES;
+    STAssertEqualObjects(image, decObj.data, @"Switched to raw storage");
+    decObj.storesRawData = NO;
+    STAssertEqualObjects(encoded.base64, decObj.base64, @"Switched back to encoded storage");
+    
+    MIGBase64 *str = [MIGBase64 createWithRawData:nil useFormatting:NO];
+    str.string = @"Testing class encoding";
+    STAssertEqualObjects(@"VGVzdGluZyBjbGFzcyBlbmNvZGluZw==", [[NSString alloc] initWithData:str.base64 encoding:NSASCIIStringEncoding], @"Raw string encoding");
+    STAssertEqualObjects(@"Testing class encoding", str.string, @"Raw string");
+}
+
 - (void)testSpeedNSData
 {
     NSMutableData* theData = [NSMutableData dataWithCapacity:1000000];
@@ -231,4 +705,73 @@
     }
 }
 
+- (void)testSmallPayload
+{
+    MIG_SmallEncoded enc;
+    MIG_SmallDecoded dec;
+    unsigned char payload[MIG_SMALL_MAX_BYTES + 1];
+    arc4random_buf(payload, sizeof(payload));
+    
+    MIG_Result res = MIG_decodeSmall("Zm9vYg==", 8, &dec);
+    STAssertEquals(MIG_OK, res, @"Small decode");
+    STAssertEquals(4u, dec.length, @"Small decode length");
+    STAssertTrue(memcmp(dec.bytes, "foob", 4) == 0, @"Small decode bytes");
+    STAssertEquals(MIG_Base64IllegalCharacter, MIG_decodeSmall("Zm9vYm\r\nYg==", 12, &dec), @"Small decode rejects separators");
+    STAssertEquals(MIG_OutputTooSmall, MIG_encodeSmall(payload, MIG_SMALL_MAX_BYTES + 1, &enc), @"Small encode limit");
+    
+    // Every size matches the allocating encoder, and round trips
+    for (unsigned int len = 0; len <= MIG_SMALL_MAX_BYTES; len++)
+    {
+        char *expected;
+        unsigned int expected_len;
+        MIG_encodeAsBase64(0, payload, len, &expected, &expected_len);
+        
+        STAssertEquals(MIG_OK, MIG_encodeSmall(payload, len, &enc), @"Small encode");
+        STAssertTrue(enc.length == expected_len && memcmp(enc.chars, expected, expected_len) == 0, @"Small encode of %u bytes", len);
+        STAssertEquals(MIG_OK, MIG_decodeSmall(enc.chars, enc.length, &dec), @"Small decode");
+        STAssertTrue(dec.length == len && memcmp(dec.bytes, payload, len) == 0, @"Small round trip of %u bytes", len);
+        free(expected);
+    }
+}
+
+- (void)testSpeedSmallPayload
+{
+    unsigned char payload[64];
+    arc4random_buf(payload, sizeof(payload));
+    MIG_SmallEncoded enc;
+    MIG_SmallDecoded dec;
+    
+    const unsigned int sizes[] = { 16, 20, 32, 64 };
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (int i = 0; i < 1000000; i++)
+        {
+            MIG_encodeSmall(payload, sizes[s], &enc);
+            MIG_decodeSmall(enc.chars, enc.length, &dec);
+        }
+    }
+}
+
+- (void)testSpeedSmallPayloadRawMIG
+{
+    unsigned char payload[64];
+    arc4random_buf(payload, sizeof(payload));
+    char *result;
+    unsigned char *result2;
+    unsigned int result_len, result_len2;
+    
+    // The same work as testSpeedSmallPayload, through the allocating calls
+    const unsigned int sizes[] = { 16, 20, 32, 64 };
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        for (int i = 0; i < 1000000; i++)
+        {
+            MIG_Result res = MIG_encodeAsBase64(0, payload, sizes[s], &result, &result_len);
+            res = MIG_decodeAsBase64(result, result_len, &result2, &result_len2);
+            free(result);
+            free(result2);
+        }
+    }
+}
+
 @end
@@ -0,0 +1,163 @@
+//
+//  MIGBase64ViewsTests.mm
+//  Base64_TestsTests
+//
+//  Tests for the C++20 range adaptors in MIGBase64Views.hpp
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#include <list>
+#include <string>
+#include <vector>
+
+#import "../../MIGBase64Views.hpp"
+
+@interface MIGBase64ViewsTests : SenTestCase
+
+@end
+
+@implementation MIGBase64ViewsTests
+
+- (void)testRangeAdaptors
+{
+    // RFC vectors, lazily and through the bulk copy
+    const char *plain[] = { "", "f", "fo", "foo", "foob", "fooba", "foobar" };
+    const char *coded[] = { "", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+    for (int i = 0; i < 7; i++)
+    {
+        std::string in(plain[i]);
+        std::string lazy;
+        for (char c : in | mig::views::base64_encode)
+            lazy += c;
+        STAssertTrue(lazy == coded[i], @"Lazy encode of '%s' failed", plain[i]);
+
+        auto view = mig::views::base64_encode(in);
+        std::string bulk(view.size(), '\0');
+        view.copy_to(bulk.data());
+        STAssertTrue(bulk == coded[i], @"Bulk encode of '%s' failed", plain[i]);
+
+        std::string decoded;
+        for (unsigned char c : std::string(coded[i]) | mig::views::base64_decode)
+            decoded += (char)c;
+        STAssertTrue(decoded == in, @"Lazy decode of '%s' failed", coded[i]);
+    }
+
+    // Formatted output matches the C encoder, for both contiguous and node based input
+    std::vector<unsigned char> bytes(1000);
+    for (size_t i = 0; i < bytes.size(); i++)
+        bytes[i] = (unsigned char)(i * 7);
+
+    char *expected = NULL;
+    unsigned int expectedLen = 0;
+    STAssertEquals(MIG_encodeAsBase64(1, bytes.data(), (unsigned int)bytes.size(), &expected, &expectedLen),
+                   MIG_OK, @"Encode failed");
+    std::string reference(expected, expectedLen);
+    free(expected);
+
+    std::list<unsigned char> nodes(bytes.begin(), bytes.end());
+    std::string formatted;
+    for (char c : nodes | mig::views::base64_encode(true))
+        formatted += c;
+    STAssertTrue(formatted == reference, @"Formatted lazy encode differs from MIG_encodeAsBase64");
+
+    std::string streamed;
+    (bytes | mig::views::base64_encode(true)).copy_to(std::back_inserter(streamed));
+    STAssertTrue(streamed == reference, @"Formatted bulk encode differs from MIG_encodeAsBase64");
+
+    // Round trip, composed with other views.  Line separators are skipped
+    std::vector<unsigned char> roundTrip;
+    for (unsigned char c : reference | mig::views::base64_decode | std::views::take(500))
+        roundTrip.push_back(c);
+    STAssertTrue(std::equal(roundTrip.begin(), roundTrip.end(), bytes.begin()) && roundTrip.size() == 500,
+                 @"Round trip through the views failed");
+
+    std::vector<unsigned char> out(bytes.size());
+    unsigned char *end = mig::views::base64_decode(reference).copy_to(out.data());
+    STAssertTrue(end - out.data() == (ptrdiff_t)bytes.size() && out == bytes, @"Bulk decode failed");
+}
+
+- (void)testDecodeViewMatchesDecoder
+{
+    // Lazy iteration and copy_to follow the rules of MIG_decodeAsBase64, for contiguous and node based input
+    const char *vectors[] = { "Zg==Zm8=", "Zm9v\r\nYmFy", "SGVs bG8=", "Zm9vY", "SGVsbG8=garbage", "A=======" };
+    for (int i = 0; i < 6; i++)
+    {
+        std::string in(vectors[i]);
+        unsigned char *expected = NULL;
+        unsigned int expectedLen = 0;
+        MIG_Result res = MIG_decodeAsBase64(in.data(), (unsigned int)in.size(), &expected, &expectedLen);
+        std::vector<unsigned char> reference;
+        if (res == MIG_OK)
+            reference.assign(expected, expected + expectedLen);
+        free(expected);
+
+        auto view = mig::views::base64_decode(in);
+        std::vector<unsigned char> lazy;
+        for (unsigned char c : view)
+            lazy.push_back(c);
+        STAssertTrue(lazy == reference && view.status() == res, @"Lazy decode of '%s' differs from MIG_decodeAsBase64", vectors[i]);
+
+        std::vector<unsigned char> bulk(in.size());
+        bulk.resize(view.copy_to(bulk.data()) - bulk.data());
+        STAssertTrue(bulk == reference && view.status() == res, @"Bulk decode of '%s' differs from MIG_decodeAsBase64", vectors[i]);
+
+        std::list<char> nodes(in.begin(), in.end());
+        auto nodeView = nodes | mig::views::base64_decode;
+        std::vector<unsigned char> fromNodes;
+        for (unsigned char c : nodeView)
+            fromNodes.push_back(c);
+        STAssertTrue(fromNodes == reference && nodeView.status() == res, @"Node based decode of '%s' differs from MIG_decodeAsBase64", vectors[i]);
+    }
+
+    // Large input crosses several blocks
+    std::vector<unsigned char> bytes(100000);
+    for (size_t i = 0; i < bytes.size(); i++)
+        bytes[i] = (unsigned char)(i * 13);
+    std::string encoded;
+    for (char c : bytes | mig::views::base64_encode(true))
+        encoded += c;
+    std::vector<unsigned char> decoded;
+    std::ranges::copy(encoded | mig::views::base64_decode, std::back_inserter(decoded));
+    STAssertTrue(decoded == bytes, @"Block decode failed");
+}
+
+- (void)testIteratorCopies
+{
+    // Copies of an iterator share the view's block buffer, so reading them in different blocks must not mix them up
+    std::vector<unsigned char> bytes(20000);
+    for (size_t i = 0; i < bytes.size(); i++)
+        bytes[i] = (unsigned char)(i * 31);
+    auto encodeView = bytes | mig::views::base64_encode(true);
+    std::string encoded;
+    encodeView.copy_to(std::back_inserter(encoded));
+    auto decodeView = mig::views::base64_decode(encoded);
+    STAssertTrue(sizeof(encodeView.begin()) < 128 && sizeof(decodeView.begin()) < 128, @"Iterators carry their blocks");
+
+    const size_t lags[] = { 1, 5000 };
+    for (size_t lag : lags)
+    {
+        auto lead = encodeView.begin(), trail = lead;
+        std::ranges::advance(lead, (std::ptrdiff_t)lag);
+        bool same = true;
+        for (size_t i = 0; lead != encodeView.end(); ++lead, ++trail, ++i)
+            same = same && *lead == encoded[i + lag] && *trail == encoded[i];
+        STAssertTrue(same, @"Encode iterators %lu apart differ", (unsigned long)lag);
+
+        auto dLead = decodeView.begin(), dTrail = dLead;
+        std::ranges::advance(dLead, (std::ptrdiff_t)lag);
+        same = true;
+        for (size_t i = 0; dLead != decodeView.end(); ++dLead, ++dTrail, ++i)
+            same = same && *dLead == bytes[i + lag] && *dTrail == bytes[i];
+        STAssertTrue(same, @"Decode iterators %lu apart differ", (unsigned long)lag);
+    }
+
+    // A later pass sees changes to the underlying bytes
+    bytes[0] ^= 0xff;
+    std::string changed;
+    for (char c : encodeView)
+        changed += c;
+    STAssertTrue(changed != encoded && changed.substr(4) == encoded.substr(4), @"Second pass reused a stale block");
+}
+
+@end
@@ -0,0 +1,166 @@
+//
+//  MIGBase64Tests.m
+//  Base64_Tests
+//
+//  Command line tests for platforms without SenTestingKit/XCTest, such as GNUstep on Linux.
+//  Built and run by 'make check' (see GNUmakefile).  Exits non-zero if any check fails.
+//
+
+#import <Foundation/Foundation.h>
+
+#import "../../NSData+MIGBase64.h"
+#import "../../NSString+MIGBase64.h"
+#import "../../MIGBase64.h"
+#import "../../MIGBase64Cache.h"
+#import "../../MIGConverter.h"
+#import "../../MIGBase64_Common.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond, description) \
+    do { if (!(cond)) { failures++; fprintf(stderr, "FAIL %s:%d: %s\n", __FILE__, __LINE__, description); } } while (0)
+
+/* Repeatable pseudo random payload */
+static NSData *payload(NSUInteger length)
+{
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    unsigned char *bytes = data.mutableBytes;
+    unsigned int x = 2463534242u;
+    for (NSUInteger i = 0; i < length; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        bytes[i] = (unsigned char)x;
+    }
+    return data;
+}
+
+static void testRFCVectors(void)
+{
+    NSError *error = nil;
+    NSString *plain[] = { @"f", @"fo", @"foo", @"foob", @"fooba", @"foobar" };
+    NSString *coded[] = { @"Zg==", @"Zm8=", @"Zm9v", @"Zm9vYg==", @"Zm9vYmE=", @"Zm9vYmFy" };
+    for (int i = 0; i < 6; i++)
+    {
+        CHECK([plain[i].Base64 isEqualToString:coded[i]], "RFC vector encoding");
+        CHECK([[coded[i] decodeBase64AsString:&error] isEqualToString:plain[i]], "RFC vector decoding");
+    }
+}
+
+static void testAppendToMutableData(void)
+{
+    NSError *error = nil;
+    NSData *image = payload(1000);
+
+    NSMutableData *message = [NSMutableData dataWithBytes:"Parts:" length:6];
+    BOOL ok = [NSData appendBase64EncodingOfBytes:"foobar" length:6 formatting:NO toData:message error:&error];
+    CHECK(ok, "Append encoding of bytes");
+    ok = [NSData appendBase64EncodingOfData:image formatting:YES toData:message error:&error];
+    CHECK(ok, "Append encoding of data");
+
+    NSMutableData *expected = [NSMutableData dataWithBytes:"Parts:Zm9vYmFy" length:14];
+    [expected appendData:[image encodeAsBase64DataUsingLineEndings:YES error:&error]];
+    CHECK([expected isEqualToData:message], "Appended encodings");
+
+    // And decode the parts back onto the end of a reused buffer
+    NSMutableData *decoded = [NSMutableData dataWithBytes:"Parts:" length:6];
+    ok = [NSData appendBase64DecodingOfChars:(const char *)message.bytes + 6 length:8 toData:decoded error:&error];
+    CHECK(ok, "Append decoding of chars");
+    NSData *encodedImage = [message subdataWithRange:NSMakeRange(14, message.length - 14)];
+    ok = [NSData appendBase64DecodingOfData:encodedImage toData:decoded error:&error];
+    CHECK(ok, "Append decoding of data");
+
+    expected = [NSMutableData dataWithBytes:"Parts:foobar" length:12];
+    [expected appendData:image];
+    CHECK([expected isEqualToData:decoded], "Appended decodings");
+
+    // Empty parts append nothing, even when their bytes are NULL
+    NSUInteger length = decoded.length;
+    CHECK([NSData appendBase64EncodingOfData:[NSData data] formatting:NO toData:decoded error:&error], "Append encoding of empty data");
+    CHECK([NSData appendBase64EncodingOfBytes:NULL length:0 formatting:YES toData:decoded error:&error], "Append encoding of no bytes");
+    CHECK([NSData appendBase64DecodingOfData:[NSData data] toData:decoded error:&error], "Append decoding of empty data");
+    CHECK([NSData appendBase64DecodingOfChars:NULL length:0 toData:decoded error:&error], "Append decoding of no chars");
+    CHECK(length == decoded.length, "Empty appends leave the buffer untouched");
+
+    // Many parts into one buffer (the first of them empty), matching the separately encoded parts
+    NSMutableData *parts = [NSMutableData data];
+    NSMutableData *reference = [NSMutableData data];
+    for (NSUInteger partLength = 0; partLength < 200; partLength++)
+    {
+        NSData *part = payload(partLength);
+        ok = [NSData appendBase64EncodingOfData:part formatting:(partLength & 1) toData:parts error:&error];
+        CHECK(ok, "Append encoding of part");
+        if (partLength > 0)
+        {
+            [reference appendData:[part encodeAsBase64DataUsingLineEndings:(partLength & 1) error:&error]];
+        }
+    }
+    CHECK([reference isEqualToData:parts], "Appended parts");
+
+    // Failures leave the buffer untouched
+    ok = [NSData appendBase64DecodingOfChars:"Zm9vY" length:5 toData:decoded error:&error];
+    CHECK(!ok, "Append decoding of invalid base64");
+    CHECK(error.code == MIG_Base64EncodingInvalid, "Append decoding error");
+    ok = [NSData appendBase64DecodingOfChars:"A=======" length:8 toData:decoded error:&error];
+    CHECK(!ok, "Append decoding of excess padding");
+    CHECK(length == decoded.length, "Failed append leaves the buffer untouched");
+}
+
+static void testStrictDecode(void)
+{
+    NSError *error = nil;
+    NSData *vector = [@"Zm9v Yg==" dataUsingEncoding:NSASCIIStringEncoding];
+    CHECK([vector decodeFromBase64DataStrict:&error] == nil, "Strict decoding rejects whitespace");
+    CHECK(error.code == MIG_Base64IllegalCharacter, "Illegal character reason");
+    CHECK([[error.userInfo objectForKey:kB64ErrorOffsetKey] unsignedIntValue] == 4, "Illegal character offset");
+}
+
+static void testBase64Class(void)
+{
+    NSData *data = payload(300);
+    MIGBase64 *b64 = [MIGBase64 createWithData:data useFormatting:YES];
+    CHECK([b64.data isEqualToData:data], "Class round trip");
+
+    MIGBase64 *raw = [MIGBase64 createWithRawData:data useFormatting:YES];
+    CHECK([raw.base64 isEqualToData:b64.base64], "Raw storage encoding");
+
+    NSData *archive = [NSKeyedArchiver archivedDataWithRootObject:raw];
+    MIGBase64 *restored = [NSKeyedUnarchiver unarchiveObjectWithData:archive];
+    CHECK([restored.data isEqualToData:data], "Raw storage archive");
+}
+
+static void testResultCache(void)
+{
+    MIGBase64Cache *cache = [[MIGBase64Cache alloc] init];
+    cache.enabled = YES;
+    [cache setEncodedString:@"Zg==" forData:[@"f" dataUsingEncoding:NSASCIIStringEncoding] formatting:NO];
+    [cache setEncodedString:@"Zm8=" forData:[@"fo" dataUsingEncoding:NSASCIIStringEncoding] formatting:NO];
+    CHECK(cache.count == 2, "Cache count");
+    cache.countLimit = 1;
+    CHECK(cache.count == 1, "Lowered count limit");
+    CHECK([MIGBase64Cache sharedCache] != nil, "Shared cache");
+}
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool
+    {
+        testRFCVectors();
+        testAppendToMutableData();
+        testStrictDecode();
+        testBase64Class();
+        testResultCache();
+    }
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -16,6 +16,11 @@
 // Note also that 'useFormatting' property ONLY applies when _setting_ 'string' or 'data'
 // properties.
 //
+// When 'storesRawData' is set, the raw bytes are stored instead (without a copy for immutable
+// or memory-mapped NSData) and the Base64 encoding is only produced, and then kept, when
+// 'base64' is first read.  Such objects archive their raw bytes rather than the encoding.
+// As the encoding is made on demand, 'useFormatting' then also applies to the next 'base64' read.
+//
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -49,6 +54,8 @@
 + (id)createWithData:(NSData *)data useFormatting:(BOOL)f;
 + (id)createWithString:(NSString *)string useFormatting:(BOOL)f;
 + (id)createWithBase64:(NSString *)base64String;
++ (id)createWithRawData:(NSData *)data useFormatting:(BOOL)f;
++ (id)createWithContentsOfFile:(NSString *)path useFormatting:(BOOL)f error:(NSError **)error;
 
 #pragma mark Initializers
 - (id)init;
@@ -56,11 +63,20 @@
 - (id)initWithString:(NSString *)string useFormatting:(BOOL)f;
 - (id)initWithBase64:(NSString *)base64String;
 
+/** Stores 'data' itself (see 'storesRawData') */
+- (id)initWithRawData:(NSData *)data useFormatting:(BOOL)f;
+
+/** Stores the contents of the file at 'path', memory mapped where it is safe to do so */
+- (id)initWithContentsOfFile:(NSString *)path useFormatting:(BOOL)f error:(NSError **)error;
+
 #pragma mark Properties
 
 /** Use formatting when encoding data */
 @property BOOL useFormatting;
 
+/** Store the raw bytes and encode on demand, rather than storing the Base64 encoding */
+@property BOOL storesRawData;
+
 /** The encapsulated base64 string */
 @property (retain) NSData *base64;
 
@@ -16,6 +16,11 @@
 // Note also that 'useFormatting' property ONLY applies when _setting_ 'string' or 'data'
 // properties.
 //
+// When 'storesRawData' is set, the raw bytes are stored instead (without a copy for immutable
+// or memory-mapped NSData) and the Base64 encoding is only produced, and then kept, when
+// 'base64' is first read.  Such objects archive their raw bytes rather than the encoding.
+// As the encoding is made on demand, 'useFormatting' then also applies to the next 'base64' read.
+//
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
 /**
@@ -50,9 +55,15 @@
 #endif
 
 @implementation MIGBase64
+{
+    NSData *_rawData;               // The raw bytes, when storing raw data
+}
 
 @dynamic string;
 @dynamic data;
+@synthesize base64 = _base64;
+@synthesize useFormatting = _useFormatting;
+@synthesize storesRawData = _storesRawData;
 
 + (id)create
 {
@@ -74,6 +85,16 @@
     return [[MIGBase64 alloc] initWithBase64:base64String];
 }
 
++ (id)createWithRawData:(NSData *)data useFormatting:(BOOL)f
+{
+    return [[MIGBase64 alloc] initWithRawData:data useFormatting:f];
+}
+
++ (id)createWithContentsOfFile:(NSString *)path useFormatting:(BOOL)f error:(NSError **)error
+{
+    return [[MIGBase64 alloc] initWithContentsOfFile:path useFormatting:f error:error];
+}
+
 - (id)init
 {
     id s = [super init];
@@ -118,27 +139,152 @@
     return s;
 }
 
+- (id)initWithRawData:(NSData *)data useFormatting:(BOOL)f
+{
+    id s = [super init];
+    if (s)
+    {
+        _useFormatting = f;
+        _storesRawData = YES;
+        self.data = data;
+    }
+    return s;
+}
+
+- (id)initWithContentsOfFile:(NSString *)path useFormatting:(BOOL)f error:(NSError **)error
+{
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:error];
+    if (data == nil)
+    {
+        return nil;
+    }
+    return [self initWithRawData:data useFormatting:f];
+}
+
 - (NSString *)description
 {
-    NSString *result = [NSString stringWithFormat:@"formatting: %@\r\nBase64: %@\r\nLength:%ld", [NSNumber numberWithBool:_useFormatting], _base64, _base64.length];
+    if (_base64 == nil && _rawData != nil)
+    {
+        // Not encoded yet.  Describing the object (logging, the debugger) mustn't encode it as a side effect
+        return [NSString stringWithFormat:@"formatting: %@\r\nRaw data length:%ld (not yet encoded)", [NSNumber numberWithBool:_useFormatting], (long)_rawData.length];
+    }
+    
+    NSString *result = [NSString stringWithFormat:@"formatting: %@\r\nBase64: %@\r\nLength:%ld", [NSNumber numberWithBool:_useFormatting], _base64, (long)_base64.length];
     return result;
 }
 
 - (void)encodeWithCoder:(NSCoder *)coder
 {
     [coder encodeBool:_useFormatting forKey:@"formatting"];
-	[coder encodeObject:_base64 forKey:@"base64"];
+    if (_storesRawData)
+    {
+        [coder encodeObject:_rawData forKey:@"data"];
+    }
+    else
+    {
+        [coder encodeObject:_base64 forKey:@"base64"];
+    }
 }
 
 - (id)initWithCoder:(NSCoder *)coder
 {
     _useFormatting = [coder decodeBoolForKey:@"formatting"];
-	_base64 = [coder decodeObjectForKey:@"base64"];
+    if ([coder containsValueForKey:@"data"])
+    {
+        _storesRawData = YES;
+        _rawData = [coder decodeObjectForKey:@"data"];
+    }
+    else
+    {
+        // Archives of objects storing their encoding, including those made before raw storage
+        _base64 = [coder decodeObjectForKey:@"base64"];
+    }
 	return self;
 }
 
+#pragma mark Storage
+
+- (BOOL)useFormatting
+{
+    return _useFormatting;
+}
+
+- (void)setUseFormatting:(BOOL)useFormatting
+{
+    if (_storesRawData && useFormatting != _useFormatting)
+    {
+        // Encoded again, with the new formatting, on the next read
+        _base64 = nil;
+    }
+    _useFormatting = useFormatting;
+}
+
+- (BOOL)storesRawData
+{
+    return _storesRawData;
+}
+
+- (void)setStoresRawData:(BOOL)storesRawData
+{
+    if (storesRawData == _storesRawData)
+    {
+        return;
+    }
+    
+    if (storesRawData)
+    {
+        // Keep the current encoding, and hold the bytes it decodes to alongside
+        NSError *err = nil;
+        NSData *raw = _base64 ? [_base64 decodeFromBase64Data:&err] : nil;
+        _lastError = err;
+        if (err)
+        {
+            return;
+        }
+        _rawData = raw;
+    }
+    else
+    {
+        _base64 = self.base64;
+        _rawData = nil;
+    }
+    _storesRawData = storesRawData;
+}
+
+- (NSData *)base64
+{
+    if (_base64 == nil && _rawData != nil)
+    {
+        NSError *err;
+        _base64 = [_rawData encodeAsBase64DataUsingLineEndings:_useFormatting error:&err];
+        _lastError = err;
+    }
+    return _base64;
+}
+
+- (void)setBase64:(NSData *)base64
+{
+    _base64 = base64;
+    if (_storesRawData)
+    {
+        NSError *err = nil;
+        _rawData = base64 ? [base64 decodeFromBase64Data:&err] : nil;
+        _lastError = err;
+    }
+}
+
+#pragma mark Conversion
+
 - (void)setData:(NSData *)data
 {
+    if (_storesRawData)
+    {
+        _rawData = [data copy];
+        _base64 = nil;
+        _lastError = nil;
+        return;
+    }
+    
     NSError *err;
     _base64 = [data encodeAsBase64DataUsingLineEndings:_useFormatting error:&err];
     _lastError = err;
@@ -146,6 +292,14 @@
 
 - (void)setString:(NSString *)str
 {
+    if (_storesRawData)
+    {
+        _rawData = [str dataUsingEncoding:NSUTF8StringEncoding];
+        _base64 = nil;
+        _lastError = nil;
+        return;
+    }
+    
     NSError *err;
     _base64 = [str encodeAsBase64DataUsingLineEndings:_useFormatting error:&err];
     _lastError = err;
@@ -153,6 +307,12 @@
 
 - (NSData *)data
 {
+    if (_storesRawData)
+    {
+        _lastError = nil;
+        return _rawData;
+    }
+    
     NSError *err;
     NSData *data = [_base64 decodeFromBase64Data:&err];
     _lastError = err;
@@ -161,6 +321,12 @@
 
 - (NSString *)string
 {
+    if (_storesRawData)
+    {
+        _lastError = nil;
+        return _rawData ? [[NSString alloc] initWithData:_rawData encoding:NSUTF8StringEncoding] : nil;
+    }
+    
     NSError *err;
     NSString *str = [_base64 decodeBase64DataAsString:&err];
     _lastError = err;
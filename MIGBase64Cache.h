@@ -0,0 +1,95 @@
+//
+//  MIGBase64Cache.h
+//  Base64_Tests
+//
+//  Opt-in, bounded, thread-safe LRU cache of encoded results for payloads that are
+//  encoded over and over again (images, fonts, signatures embedded as data: URIs).
+//
+//  Results are keyed by a fast hash of the input bytes and the formatting flag, and the
+//  input bytes are compared on a hit, so a collision can never return the wrong result.
+//  The returned NSData/NSString objects are immutable and shared between callers.
+//
+//  The NSData (MIGBase64_FAST) encoders consult the shared cache automatically once it
+//  has been enabled.
+//
+
+/**
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#import <Foundation/Foundation.h>
+
+@interface MIGBase64Cache : NSObject
+
+#pragma mark Shared instance
+
+/** The cache used by the NSData (MIGBase64_FAST) encoders.  Disabled until 'enabled' is set */
++ (MIGBase64Cache *)sharedCache;
+
+#pragma mark Configuration
+
+/** Caching is opt-in.  While NO, nothing is looked up or stored */
+@property (getter=isEnabled) BOOL enabled;
+
+/** Maximum number of cached results (0 == unlimited).  Defaults to 256 */
+@property NSUInteger countLimit;
+
+/** Maximum number of bytes (input plus encoded result) held by the cache (0 == unlimited).
+ Defaults to 16MB */
+@property NSUInteger sizeLimit;
+
+/** Only payloads whose length lies within [minimumLength, maximumLength] are cached.
+ Default to 0 and NSUIntegerMax */
+@property NSUInteger minimumLength;
+@property NSUInteger maximumLength;
+
+#pragma mark Statistics
+
+@property (readonly) NSUInteger hitCount;
+@property (readonly) NSUInteger missCount;
+
+/** The number of cached results, and the bytes they hold */
+@property (readonly) NSUInteger count;
+@property (readonly) NSUInteger size;
+
+- (void)resetStatistics;
+
+#pragma mark Access
+
+/** YES if the cache is enabled and a payload of 'length' bytes falls within the size thresholds */
+- (BOOL)shouldCacheLength:(NSUInteger)length;
+
+/** Returns the cached encoding of 'data', or nil (counting a miss) if there isn't one */
+- (NSData *)encodedDataForData:(NSData *)data
+                    formatting:(BOOL)useOptionalLineEndings;
+- (NSString *)encodedStringForData:(NSData *)data
+                        formatting:(BOOL)useOptionalLineEndings;
+
+/** Stores the encoding of 'data', evicting the least recently used results to stay within the limits */
+- (void)setEncodedData:(NSData *)encoded
+               forData:(NSData *)data
+            formatting:(BOOL)useOptionalLineEndings;
+- (void)setEncodedString:(NSString *)encoded
+                 forData:(NSData *)data
+              formatting:(BOOL)useOptionalLineEndings;
+
+- (void)removeAllObjects;
+
+@end
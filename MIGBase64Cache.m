@@ -0,0 +1,446 @@
+//
+//  MIGBase64Cache.m
+//  Base64_Tests
+//
+//  Opt-in, bounded, thread-safe LRU cache of encoded results for payloads that are
+//  encoded over and over again (images, fonts, signatures embedded as data: URIs).
+//
+
+/**
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#import "MIGBase64Cache.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#if !__has_feature(objc_arc)
+#error MIGBase64+categories must be built with ARC.
+#endif
+
+#pragma mark -
+#pragma mark Hashing
+
+/* Fast 64-bit hash of the input, consuming 8 bytes per step */
+static uint64_t MIGHashBytes(const unsigned char *p, size_t len, uint64_t seed)
+{
+    const uint64_t m1 = 0x9E3779B97F4A7C15ULL;
+    const uint64_t m2 = 0xBF58476D1CE4E5B9ULL;
+    uint64_t h = seed ^ (len * m1);
+    uint64_t k;
+
+    while (len >= 8)
+    {
+        memcpy(&k, p, 8);
+        k *= m1;
+        k ^= k >> 29;
+        h = (h ^ k) * m2;
+        p += 8;
+        len -= 8;
+    }
+
+    // The tail.  'p' may be NULL for empty data, which memcpy mustn't be given even for 0 bytes
+    k = 0;
+    if (len > 0)
+    {
+        memcpy(&k, p, len);
+    }
+    h = (h ^ (k * m1)) * m2;
+
+    h ^= h >> 31;
+    h *= m1;
+    h ^= h >> 33;
+    return h;
+}
+
+#pragma mark -
+#pragma mark Cache entry
+
+@interface MIGBase64CacheEntry : NSObject
+{
+@public
+    uint64_t hash;
+    BOOL formatting;
+    NSData *source;                                 // Copy of the input, compared on every hit
+    NSData *encodedData;
+    NSString *encodedString;
+    NSUInteger size;
+    MIGBase64CacheEntry *next;                      // Towards the least recently used
+    __unsafe_unretained MIGBase64CacheEntry *prev;  // Towards the most recently used
+}
+@end
+
+@implementation MIGBase64CacheEntry
+@end
+
+#pragma mark -
+#pragma mark Cache
+
+@implementation MIGBase64Cache
+{
+    NSLock *_lock;
+    NSMutableDictionary *_entries;                  // hash -> entry
+    MIGBase64CacheEntry *_head;                     // Most recently used
+    __unsafe_unretained MIGBase64CacheEntry *_tail; // Least recently used
+
+    // Every property is backed by state shared between threads, so all of them take _lock
+    BOOL _enabled;
+    NSUInteger _countLimit;
+    NSUInteger _sizeLimit;
+    NSUInteger _minimumLength;
+    NSUInteger _maximumLength;
+    NSUInteger _hitCount;
+    NSUInteger _missCount;
+    NSUInteger _size;
+}
+
+static MIGBase64Cache *sharedCache = nil;
+
++ (void)initialize
+{
+    // The runtime runs this once, before any other message, so no libdispatch is needed (eg. GNUstep)
+    if (self == [MIGBase64Cache class])
+    {
+        sharedCache = [[MIGBase64Cache alloc] init];
+    }
+}
+
++ (MIGBase64Cache *)sharedCache
+{
+    return sharedCache;
+}
+
+- (id)init
+{
+    id s = [super init];
+    if (s)
+    {
+        _lock = [[NSLock alloc] init];
+        _entries = [NSMutableDictionary dictionary];
+        _enabled = NO;
+        _countLimit = 256;
+        _sizeLimit = 16 * 1024 * 1024;
+        _minimumLength = 0;
+        _maximumLength = NSUIntegerMax;
+    }
+    return s;
+}
+
+#pragma mark Configuration
+
+- (BOOL)isEnabled
+{
+    [_lock lock];
+    BOOL enabled = _enabled;
+    [_lock unlock];
+    return enabled;
+}
+
+- (void)setEnabled:(BOOL)enabled
+{
+    [_lock lock];
+    _enabled = enabled;
+    [_lock unlock];
+}
+
+- (NSUInteger)countLimit
+{
+    [_lock lock];
+    NSUInteger limit = _countLimit;
+    [_lock unlock];
+    return limit;
+}
+
+- (void)setCountLimit:(NSUInteger)countLimit
+{
+    // Trim straight away when the limit is lowered, rather than on the next store
+    [_lock lock];
+    _countLimit = countLimit;
+    [self evict];
+    [_lock unlock];
+}
+
+- (NSUInteger)sizeLimit
+{
+    [_lock lock];
+    NSUInteger limit = _sizeLimit;
+    [_lock unlock];
+    return limit;
+}
+
+- (void)setSizeLimit:(NSUInteger)sizeLimit
+{
+    [_lock lock];
+    _sizeLimit = sizeLimit;
+    [self evict];
+    [_lock unlock];
+}
+
+- (NSUInteger)minimumLength
+{
+    [_lock lock];
+    NSUInteger length = _minimumLength;
+    [_lock unlock];
+    return length;
+}
+
+- (void)setMinimumLength:(NSUInteger)minimumLength
+{
+    [_lock lock];
+    _minimumLength = minimumLength;
+    [_lock unlock];
+}
+
+- (NSUInteger)maximumLength
+{
+    [_lock lock];
+    NSUInteger length = _maximumLength;
+    [_lock unlock];
+    return length;
+}
+
+- (void)setMaximumLength:(NSUInteger)maximumLength
+{
+    [_lock lock];
+    _maximumLength = maximumLength;
+    [_lock unlock];
+}
+
+#pragma mark Statistics
+
+- (NSUInteger)hitCount
+{
+    [_lock lock];
+    NSUInteger count = _hitCount;
+    [_lock unlock];
+    return count;
+}
+
+- (NSUInteger)missCount
+{
+    [_lock lock];
+    NSUInteger count = _missCount;
+    [_lock unlock];
+    return count;
+}
+
+- (NSUInteger)size
+{
+    [_lock lock];
+    NSUInteger size = _size;
+    [_lock unlock];
+    return size;
+}
+
+- (NSUInteger)count
+{
+    [_lock lock];
+    NSUInteger count = _entries.count;
+    [_lock unlock];
+    return count;
+}
+
+- (void)resetStatistics
+{
+    [_lock lock];
+    _hitCount = 0;
+    _missCount = 0;
+    [_lock unlock];
+}
+
+#pragma mark LRU list (lock must be held)
+
+- (void)unlink:(MIGBase64CacheEntry *)entry
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        _head = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        _tail = entry->prev;
+
+    entry->next = nil;
+    entry->prev = nil;
+}
+
+- (void)pushFront:(MIGBase64CacheEntry *)entry
+{
+    entry->prev = nil;
+    entry->next = _head;
+    if (_head)
+        _head->prev = entry;
+    _head = entry;
+    if (!_tail)
+        _tail = entry;
+}
+
+- (void)remove:(MIGBase64CacheEntry *)entry
+{
+    _size -= entry->size;
+    [self unlink:entry];
+    [_entries removeObjectForKey:[NSNumber numberWithUnsignedLongLong:entry->hash]];
+}
+
+/* Accounts for the other representation of the result, made on a hit */
+- (void)grow:(MIGBase64CacheEntry *)entry by:(NSUInteger)bytes
+{
+    entry->size += bytes;
+    _size += bytes;
+}
+
+- (void)evict
+{
+    while (_tail && ((_countLimit > 0 && _entries.count > _countLimit) ||
+                     (_sizeLimit > 0 && _size > _sizeLimit)))
+    {
+        [self remove:_tail];
+    }
+}
+
+- (MIGBase64CacheEntry *)lookup:(NSData *)data
+                           hash:(uint64_t)hash
+                     formatting:(BOOL)useOptionalLineEndings
+{
+    MIGBase64CacheEntry *entry = [_entries objectForKey:[NSNumber numberWithUnsignedLongLong:hash]];
+    if (entry && entry->formatting == useOptionalLineEndings && [entry->source isEqualToData:data])
+    {
+        _hitCount++;
+        [self unlink:entry];
+        [self pushFront:entry];
+        return entry;
+    }
+
+    _missCount++;
+    return nil;
+}
+
+- (void)store:(NSData *)data
+         hash:(uint64_t)hash
+   formatting:(BOOL)useOptionalLineEndings
+  encodedData:(NSData *)encodedData
+encodedString:(NSString *)encodedString
+{
+    MIGBase64CacheEntry *entry = [[MIGBase64CacheEntry alloc] init];
+    entry->hash = hash;
+    entry->formatting = useOptionalLineEndings;
+    entry->source = [data copy];
+    entry->encodedData = encodedData;
+    entry->encodedString = encodedString;
+    entry->size = data.length + (encodedData ? encodedData.length : encodedString.length);
+
+    [_lock lock];
+    MIGBase64CacheEntry *existing = [_entries objectForKey:[NSNumber numberWithUnsignedLongLong:hash]];
+    if (existing)
+    {
+        [self remove:existing];
+    }
+    [_entries setObject:entry forKey:[NSNumber numberWithUnsignedLongLong:hash]];
+    [self pushFront:entry];
+    _size += entry->size;
+    [self evict];
+    [_lock unlock];
+}
+
+#pragma mark Access
+
+- (BOOL)shouldCacheLength:(NSUInteger)length
+{
+    [_lock lock];
+    BOOL should = _enabled && length >= _minimumLength && length <= _maximumLength;
+    [_lock unlock];
+    return should;
+}
+
+- (NSData *)encodedDataForData:(NSData *)data
+                    formatting:(BOOL)useOptionalLineEndings
+{
+    uint64_t hash = MIGHashBytes(data.bytes, data.length, useOptionalLineEndings ? 1 : 0);
+
+    [_lock lock];
+    MIGBase64CacheEntry *entry = [self lookup:data hash:hash formatting:useOptionalLineEndings];
+    if (entry && !entry->encodedData)
+    {
+        entry->encodedData = [entry->encodedString dataUsingEncoding:NSASCIIStringEncoding];
+        [self grow:entry by:entry->encodedData.length];
+    }
+    NSData *result = entry ? entry->encodedData : nil;
+    [self evict];
+    [_lock unlock];
+    return result;
+}
+
+- (NSString *)encodedStringForData:(NSData *)data
+                        formatting:(BOOL)useOptionalLineEndings
+{
+    uint64_t hash = MIGHashBytes(data.bytes, data.length, useOptionalLineEndings ? 1 : 0);
+
+    [_lock lock];
+    MIGBase64CacheEntry *entry = [self lookup:data hash:hash formatting:useOptionalLineEndings];
+    if (entry && !entry->encodedString)
+    {
+        entry->encodedString = [[NSString alloc] initWithData:entry->encodedData encoding:NSASCIIStringEncoding];
+        [self grow:entry by:entry->encodedString.length];
+    }
+    NSString *result = entry ? entry->encodedString : nil;
+    [self evict];
+    [_lock unlock];
+    return result;
+}
+
+- (void)setEncodedData:(NSData *)encoded
+               forData:(NSData *)data
+            formatting:(BOOL)useOptionalLineEndings
+{
+    uint64_t hash = MIGHashBytes(data.bytes, data.length, useOptionalLineEndings ? 1 : 0);
+    [self store:data hash:hash formatting:useOptionalLineEndings encodedData:encoded encodedString:nil];
+}
+
+- (void)setEncodedString:(NSString *)encoded
+                 forData:(NSData *)data
+              formatting:(BOOL)useOptionalLineEndings
+{
+    uint64_t hash = MIGHashBytes(data.bytes, data.length, useOptionalLineEndings ? 1 : 0);
+    [self store:data hash:hash formatting:useOptionalLineEndings encodedData:nil encodedString:encoded];
+}
+
+- (void)removeAllObjects
+{
+    [_lock lock];
+    while (_tail)
+    {
+        [self remove:_tail];
+    }
+    [_lock unlock];
+}
+
+- (void)dealloc
+{
+    // Unlink iteratively, rather than letting a long 'next' chain release recursively
+    while (_tail)
+    {
+        [self remove:_tail];
+    }
+}
+
+@end
@@ -0,0 +1,670 @@
+//
+//  MIGBase64Views.hpp
+//  Base64_Tests
+//
+//  C++20 range adaptors over the MIGConverter routines.  The views encode or decode lazily,
+//  so base64 can be composed with other lazy pipelines without materialising intermediate
+//  buffers:
+//
+//      auto chars = payload | mig::views::base64_encode(true);       // MIME line endings
+//      auto bytes = text | mig::views::base64_decode;
+//
+//  When the underlying range is contiguous, a block of a few KB at a time is converted into
+//  a buffer held by the view (the iterators only mark out their block, so they are cheap to
+//  copy), and copy_to() hands the kernels the whole range at once.  Other ranges are converted
+//  a quantum at a time.  Iterators refer to their view, so the view must outlive them.
+//
+
+/**
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef MIGBase64Views_hpp
+#define MIGBase64Views_hpp
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+#include "MIGConverter.h"
+
+namespace mig {
+
+namespace detail {
+
+inline constexpr char CA[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* The 6-bit value of a Base64 character, -1 if illegal.  '=' decodes as 0, as in MIGConverter.c */
+constexpr int IA(unsigned char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    if (c == '=') return 0;
+    return -1;
+}
+
+template <class T>
+concept byte_like = sizeof(T) == 1 && (std::integral<T> || std::same_as<T, std::byte>);
+
+/* Pointers to byte sized objects can be written to directly by the kernels */
+template <class O>
+concept byte_pointer = std::is_pointer_v<O> && byte_like<std::remove_pointer_t<O>> &&
+                       !std::is_const_v<std::remove_pointer_t<O>>;
+
+template <class V>
+concept contiguous_bytes = std::ranges::contiguous_range<V> && std::ranges::sized_range<V> &&
+                           byte_like<std::ranges::range_value_t<V>>;
+
+/* Contiguous ranges whose iterators can be converted a block at a time */
+template <class V>
+concept contiguous_blocks = contiguous_bytes<V> &&
+                            std::sized_sentinel_for<std::ranges::sentinel_t<V>, std::ranges::iterator_t<V>>;
+
+inline constexpr std::size_t encode_block = 57 * 48;    /* Input bytes per block: whole 76 char lines */
+inline constexpr std::size_t decode_block = 4096;       /* Input chars per block */
+
+/* The encoded length of sLen > 0 bytes, matching MIG_encodedLength */
+constexpr std::size_t encoded_length(std::size_t sLen, bool formatting)
+{
+    std::size_t cCnt = ((sLen - 1) / 3 + 1) << 2;
+    return cCnt + (formatting ? (cCnt - 1) / 76 << 1 : 0);
+}
+
+/* Checks [first, last) with the rules of MIG_decodedLength: a whole number of quanta, and no more than
+   two '=' after the last character with a non zero value (not counting the first character) */
+template <class I, class S>
+MIG_Result validate(I first, S last)
+{
+    std::size_t legal = 0, pad = 0;
+    for (bool leading = true; first != last; ++first, leading = false)
+    {
+        unsigned char r = static_cast<unsigned char>(*first);
+        int c = IA(r);
+        if (c < 0)
+            continue;
+
+        legal++;
+        if (c > 0)
+            pad = 0;
+        else if (r == '=' && !leading)
+            pad++;
+    }
+    return (legal & 3) == 0 && pad <= 2 ? MIG_OK : MIG_Base64EncodingInvalid;
+}
+
+template <class V>
+using iterator_concept_for = std::conditional_t<std::ranges::forward_range<V>,
+                                                std::forward_iterator_tag,
+                                                std::input_iterator_tag>;
+
+} // namespace detail
+
+#pragma mark -
+#pragma mark Encoding view
+
+/** Lazily Base64 encodes a range of bytes, optionally with MIME (76 char, CRLF) line endings */
+template <std::ranges::view V>
+    requires std::ranges::input_range<V> && detail::byte_like<std::ranges::range_value_t<V>>
+class base64_encode_view : public std::ranges::view_interface<base64_encode_view<V>>
+{
+    static constexpr bool blocks = detail::contiguous_blocks<V>;
+
+public:
+    /* Contiguous ranges are encoded a block at a time into the view's buffer, so the iterators
+       stay small and cheap to copy.  Each iterator marks out its block, and the block is encoded
+       again if another iterator has since used the buffer */
+    class iterator
+    {
+    public:
+        using iterator_concept = detail::iterator_concept_for<V>;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = char;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        iterator(base64_encode_view *parent, std::ranges::iterator_t<V> cur, std::ranges::sentinel_t<V> end, bool formatting)
+            : parent_(parent), cur_(std::move(cur)), end_(std::move(end)), formatting_(formatting)
+        {
+            fill();
+        }
+
+        char operator*() const
+        {
+            if constexpr (blocks)
+                return parent_->block(blk_, static_cast<std::size_t>(std::to_address(cur_) - blk_), lead_)[pos_];
+            else
+                return buf_[pos_];
+        }
+
+        iterator &operator++()
+        {
+            if (++pos_ == len_)
+                fill();
+            return *this;
+        }
+
+        void operator++(int) requires (!std::ranges::forward_range<V>) { ++*this; }
+
+        iterator operator++(int) requires std::ranges::forward_range<V>
+        {
+            iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        friend bool operator==(const iterator &it, std::default_sentinel_t) { return it.len_ == 0; }
+
+        friend bool operator==(const iterator &a, const iterator &b) requires std::ranges::forward_range<V>
+        {
+            return a.cur_ == b.cur_ && a.pos_ == b.pos_ && a.len_ == b.len_;
+        }
+
+    private:
+        /* Moves on to the next block, or encodes the next quantum when the range isn't contiguous */
+        void fill()
+        {
+            pos_ = len_ = 0;
+            if (cur_ == end_)
+                return;
+
+            if constexpr (blocks)
+            {
+                /* Whole lines at a time, so the line ending between blocks leads the block */
+                std::size_t n = std::min(detail::encode_block, static_cast<std::size_t>(end_ - cur_));
+                lead_ = formatting_ && started_;
+                blk_ = reinterpret_cast<const unsigned char *>(std::to_address(cur_));
+                len_ = detail::encoded_length(n, formatting_) + (lead_ ? 2 : 0);
+                cur_ += n;
+                started_ = true;
+                return;
+            }
+
+            /* A quantum at a time, preceded by a line separator after every 19 quanta */
+
+            if (formatting_ && quanta_ == 19)
+            {
+                buf_[len_++] = '\r';
+                buf_[len_++] = '\n';
+                quanta_ = 0;
+            }
+
+            unsigned char in[3] = { 0, 0, 0 };
+            int n = 0;
+            for (; n < 3 && cur_ != end_; ++n, ++cur_)
+                in[n] = static_cast<unsigned char>(*cur_);
+
+            int i = in[0] << 16 | in[1] << 8 | in[2];
+            buf_[len_++] = detail::CA[(i >> 18) & 0x3f];
+            buf_[len_++] = detail::CA[(i >> 12) & 0x3f];
+            buf_[len_++] = n > 1 ? detail::CA[(i >> 6) & 0x3f] : '=';
+            buf_[len_++] = n > 2 ? detail::CA[i & 0x3f] : '=';
+            ++quanta_;
+        }
+
+        base64_encode_view *parent_ = nullptr;
+        std::ranges::iterator_t<V> cur_ = std::ranges::iterator_t<V>();
+        std::ranges::sentinel_t<V> end_ = std::ranges::sentinel_t<V>();
+        bool formatting_ = false;
+        bool started_ = false;      /* A block has been marked out */
+        bool lead_ = false;         /* The block starts with a line ending */
+        const unsigned char *blk_ = nullptr;    /* The bytes of the current block, up to cur_ */
+        char buf_[blocks ? 1 : 6] = {};
+        std::size_t len_ = 0;       /* Chars in the block or buf_, 0 at the end of the range */
+        std::size_t pos_ = 0;
+        unsigned char quanta_ = 0;  /* Quanta on the current line */
+    };
+
+    base64_encode_view() requires std::default_initializable<V> = default;
+
+    constexpr base64_encode_view(V base, bool formatting = false)
+        : base_(std::move(base)), formatting_(formatting)
+    {
+    }
+
+    constexpr V base() const & requires std::copy_constructible<V> { return base_; }
+    constexpr V base() && { return std::move(base_); }
+
+    iterator begin()
+    {
+        loaded_ = nullptr;      /* The bytes may have changed since the last pass */
+        return iterator(this, std::ranges::begin(base_), std::ranges::end(base_), formatting_);
+    }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+    /** The encoded length, matching MIG_encodedLength */
+    std::size_t size() requires std::ranges::sized_range<V>
+    {
+        std::size_t sLen = std::ranges::size(base_);
+        return sLen > 0 ? detail::encoded_length(sLen, formatting_) : 0;
+    }
+
+    /** Writes the whole encoding to 'out'.  Contiguous input is encoded by MIG_encodeAsBase64Into,
+        directly into 'out' if it is a byte pointer, otherwise through a small stack buffer */
+    template <std::weakly_incrementable O>
+        requires std::indirectly_writable<O, char>
+    O copy_to(O out)
+    {
+        if constexpr (detail::contiguous_bytes<V>)
+        {
+            const unsigned char *sArr = reinterpret_cast<const unsigned char *>(std::ranges::data(base_));
+            std::size_t sLen = std::ranges::size(base_);
+            int fmt = formatting_ ? 1 : 0;
+
+            if constexpr (detail::byte_pointer<O>)
+            {
+                unsigned int written = 0;
+                MIG_encodeAsBase64Into(fmt, sArr, static_cast<unsigned int>(sLen),
+                                       reinterpret_cast<char *>(out), static_cast<unsigned int>(size()), &written);
+                return out + written;
+            }
+            else
+            {
+                /* Whole lines at a time, so the line endings between blocks can be added here */
+                constexpr std::size_t block = 57 * 48;
+                char buf[(block / 57) * 78];
+                for (std::size_t s = 0; s < sLen; s += block)
+                {
+                    std::size_t n = std::min(block, sLen - s);
+                    unsigned int written = 0;
+                    MIG_encodeAsBase64Into(fmt, sArr + s, static_cast<unsigned int>(n), buf, sizeof(buf), &written);
+                    if (s > 0 && fmt)
+                    {
+                        *out = '\r'; ++out;
+                        *out = '\n'; ++out;
+                    }
+                    out = std::ranges::copy(buf, buf + written, std::move(out)).out;
+                }
+                return out;
+            }
+        }
+        else
+        {
+            for (auto it = begin(); it != end(); ++it)
+            {
+                *out = *it;
+                ++out;
+            }
+            return out;
+        }
+    }
+
+private:
+    /* The encoding of the n bytes at sArr, led by a line ending if 'lead', in buf_ */
+    const char *block(const unsigned char *sArr, std::size_t n, bool lead)
+    {
+        if (sArr != loaded_)
+        {
+            std::size_t len = 0;
+            if (lead)
+            {
+                buf_[len++] = '\r';
+                buf_[len++] = '\n';
+            }
+            unsigned int written = 0;
+            MIG_encodeAsBase64Into(formatting_ ? 1 : 0, sArr, static_cast<unsigned int>(n),
+                                   buf_ + len, static_cast<unsigned int>(sizeof(buf_) - len), &written);
+            loaded_ = sArr;
+        }
+        return buf_;
+    }
+
+    V base_ = V();
+    bool formatting_ = false;
+    const unsigned char *loaded_ = nullptr;     /* The block encoded in buf_ */
+    char buf_[blocks ? detail::encode_block / 57 * 78 : 1] = {};
+};
+
+template <class R>
+base64_encode_view(R &&, bool) -> base64_encode_view<std::views::all_t<R>>;
+
+template <class R>
+base64_encode_view(R &&) -> base64_encode_view<std::views::all_t<R>>;
+
+#pragma mark -
+#pragma mark Decoding view
+
+/** Lazily decodes a range of Base64 characters into bytes (unsigned char), with the same rules and
+    results as MIG_decodeAsBase64: illegal characters (line separators, whitespace etc.) are skipped,
+    and input that MIG_decodeAsBase64 rejects decodes to nothing and sets status().
+    Forward ranges are validated when iteration begins.  Single pass ranges can only be validated as
+    they are read, so for those bytes may already have been produced when status() reports an error. */
+template <std::ranges::view V>
+    requires std::ranges::input_range<V> && detail::byte_like<std::ranges::range_value_t<V>>
+class base64_decode_view : public std::ranges::view_interface<base64_decode_view<V>>
+{
+    static constexpr bool blocks = detail::contiguous_blocks<V>;
+
+public:
+    /* As with base64_encode_view, contiguous ranges are decoded a block at a time into the view's buffer */
+    class iterator
+    {
+    public:
+        using iterator_concept = detail::iterator_concept_for<V>;
+        using iterator_category = std::input_iterator_tag;
+        using value_type = unsigned char;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+
+        iterator(base64_decode_view *parent, std::ranges::iterator_t<V> cur, std::ranges::sentinel_t<V> end, std::size_t left)
+            : parent_(parent), cur_(std::move(cur)), end_(std::move(end)), left_(left)
+        {
+            fill();
+        }
+
+        unsigned char operator*() const
+        {
+            if constexpr (blocks)
+                return parent_->block(blk_, static_cast<std::size_t>(std::to_address(cur_) - blk_), len_)[pos_];
+            else
+                return buf_[pos_];
+        }
+
+        iterator &operator++()
+        {
+            if (++pos_ == len_)
+                fill();
+            return *this;
+        }
+
+        void operator++(int) requires (!std::ranges::forward_range<V>) { ++*this; }
+
+        iterator operator++(int) requires std::ranges::forward_range<V>
+        {
+            iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        friend bool operator==(const iterator &it, std::default_sentinel_t) { return it.len_ == 0; }
+
+        friend bool operator==(const iterator &a, const iterator &b) requires std::ranges::forward_range<V>
+        {
+            return a.cur_ == b.cur_ && a.pos_ == b.pos_ && a.len_ == b.len_;
+        }
+
+    private:
+        /* Moves on to the next block, or decodes the next quantum when the range isn't contiguous */
+        void fill()
+        {
+            pos_ = len_ = 0;
+
+            if constexpr (blocks)
+            {
+                /* The whole range was validated by begin(), and 'left_' bytes remain */
+                if (left_ == 0)
+                    return;
+
+                const char *p = reinterpret_cast<const char *>(std::to_address(cur_));
+                std::size_t avail = static_cast<std::size_t>(end_ - cur_);
+                std::size_t n = std::min(detail::decode_block, avail);
+                unsigned int legal = MIG_legalLength(p, static_cast<unsigned int>(n));
+                if (n < avail)
+                {
+                    /* End the block on a quantum: run on over a long stretch of separators, or drop the partial quantum */
+                    for (; legal < 4 && n < avail; ++n)
+                    {
+                        if (detail::IA(static_cast<unsigned char>(p[n])) >= 0)
+                            ++legal;
+                    }
+                    for (unsigned int rem = legal & 3; rem > 0; --n)
+                    {
+                        if (detail::IA(static_cast<unsigned char>(p[n - 1])) >= 0)
+                            --rem;
+                    }
+                    legal &= ~3u;
+                }
+
+                /* The last block stops short of the padding */
+                len_ = std::min(static_cast<std::size_t>(legal / 4 * 3), left_);
+                blk_ = p;
+                cur_ += n;
+                left_ -= len_;
+                return;
+            }
+
+            /* A quantum at a time.  Each quantum is held back until the next one is complete, as the
+               padding at the end of the range says how much of the last quantum is kept */
+            while (!done_)
+            {
+                int i = 0, j = 0;
+                for (; j < 4 && cur_ != end_; ++cur_, first_ = false)
+                {
+                    unsigned char r = static_cast<unsigned char>(*cur_);
+                    int c = detail::IA(r);
+                    if (c < 0)
+                        continue;
+
+                    /* As MIG_decodedLength, count the '=' after the last character with a non zero value */
+                    if (c > 0)
+                        pad_ = 0;
+                    else if (r == '=' && !first_)
+                        pad_++;
+                    i |= c << (18 - j++ * 6);
+                }
+
+                if (j == 4)
+                {
+                    bool ready = held_;
+                    std::copy(next_, next_ + 3, buf_);
+                    next_[0] = static_cast<unsigned char>(i >> 16);
+                    next_[1] = static_cast<unsigned char>(i >> 8);
+                    next_[2] = static_cast<unsigned char>(i);
+                    held_ = true;
+                    if (ready)
+                    {
+                        len_ = 3;
+                        return;
+                    }
+                    continue;
+                }
+
+                done_ = true;
+                if (j != 0 || pad_ > 2)
+                {
+                    /* A partial quantum, or too much padding */
+                    if (parent_)
+                        parent_->status_ = MIG_Base64EncodingInvalid;
+                    return;
+                }
+                if (held_)
+                {
+                    std::copy(next_, next_ + 3, buf_);
+                    len_ = 3 - pad_;
+                }
+            }
+        }
+
+        base64_decode_view *parent_ = nullptr;
+        std::ranges::iterator_t<V> cur_ = std::ranges::iterator_t<V>();
+        std::ranges::sentinel_t<V> end_ = std::ranges::sentinel_t<V>();
+        std::size_t left_ = 0;      /* Bytes still to be decoded (contiguous ranges) */
+        const char *blk_ = nullptr; /* The chars of the current block, up to cur_ */
+        unsigned char buf_[blocks ? 1 : 3] = {};
+        std::size_t len_ = 0;       /* Bytes in the block or buf_, 0 at the end of the range */
+        std::size_t pos_ = 0;
+        unsigned char next_[3] = {};    /* The quantum held back */
+        bool held_ = false;
+        bool done_ = false;         /* The end of the range has been reached */
+        bool first_ = true;         /* Reading the first character of the range */
+        int pad_ = 0;               /* Trailing '=' seen so far */
+    };
+
+    base64_decode_view() requires std::default_initializable<V> = default;
+
+    constexpr explicit base64_decode_view(V base)
+        : base_(std::move(base))
+    {
+    }
+
+    constexpr V base() const & requires std::copy_constructible<V> { return base_; }
+    constexpr V base() && { return std::move(base_); }
+
+    /** Begins a decoding.  For forward ranges the input is validated first, and an invalid input
+        gives an empty range */
+    iterator begin()
+    {
+        status_ = MIG_OK;
+        loaded_ = nullptr;
+        std::size_t left = 0;
+        if constexpr (detail::contiguous_blocks<V>)
+        {
+            unsigned int dLen = 0;
+            if (std::ranges::size(base_) > 0)
+                status_ = MIG_decodedLength(reinterpret_cast<const char *>(std::ranges::data(base_)),
+                                            static_cast<unsigned int>(std::ranges::size(base_)), &dLen);
+            if (status_ != MIG_OK)
+                return iterator();
+            left = dLen;
+        }
+        else if constexpr (std::ranges::forward_range<V>)
+        {
+            status_ = detail::validate(std::ranges::begin(base_), std::ranges::end(base_));
+            if (status_ != MIG_OK)
+                return iterator();
+        }
+        return iterator(this, std::ranges::begin(base_), std::ranges::end(base_), left);
+    }
+
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+    /** MIG_OK, or MIG_Base64EncodingInvalid if the input isn't valid Base64 (see the class comment) */
+    MIG_Result status() const noexcept { return status_; }
+
+    /** Writes the whole decoding to 'out', or nothing if the input is invalid (see status()).
+        Contiguous input going to a byte pointer is decoded in one go by MIG_decodeAsBase64Into */
+    template <std::weakly_incrementable O>
+        requires std::indirectly_writable<O, unsigned char>
+    O copy_to(O out)
+    {
+        if constexpr (detail::contiguous_bytes<V> && detail::byte_pointer<O>)
+        {
+            const char *sArr = reinterpret_cast<const char *>(std::ranges::data(base_));
+            unsigned int sLen = static_cast<unsigned int>(std::ranges::size(base_));
+            unsigned int dLen = 0;
+            status_ = sLen > 0 ? MIG_decodedLength(sArr, sLen, &dLen) : MIG_OK;
+            if (status_ != MIG_OK || dLen == 0)
+                return out;
+
+            MIG_decodeAsBase64Into(sArr, sLen, reinterpret_cast<unsigned char *>(out), dLen);
+            return out + dLen;
+        }
+        else
+        {
+            for (auto it = begin(); it != end(); ++it)
+            {
+                *out = *it;
+                ++out;
+            }
+            return out;
+        }
+    }
+
+private:
+    /* The first dLen bytes decoded from the n chars at sArr, in buf_ */
+    const unsigned char *block(const char *sArr, std::size_t n, std::size_t dLen)
+    {
+        if (sArr != loaded_)
+        {
+            MIG_decodeAsBase64Into(sArr, static_cast<unsigned int>(n), buf_, static_cast<unsigned int>(dLen));
+            loaded_ = sArr;
+        }
+        return buf_;
+    }
+
+    V base_ = V();
+    MIG_Result status_ = MIG_OK;
+    const char *loaded_ = nullptr;      /* The block decoded in buf_ */
+    unsigned char buf_[blocks ? detail::decode_block / 4 * 3 : 1] = {};
+};
+
+template <class R>
+base64_decode_view(R &&) -> base64_decode_view<std::views::all_t<R>>;
+
+#pragma mark -
+#pragma mark Range adaptor objects
+
+namespace views {
+
+namespace detail {
+
+struct base64_encode_closure
+{
+    bool formatting;
+
+    template <std::ranges::viewable_range R>
+    friend auto operator|(R &&r, const base64_encode_closure &c)
+    {
+        return base64_encode_view(std::views::all(std::forward<R>(r)), c.formatting);
+    }
+};
+
+struct base64_encode_fn
+{
+    template <std::ranges::viewable_range R>
+    auto operator()(R &&r, bool formatting = false) const
+    {
+        return base64_encode_view(std::views::all(std::forward<R>(r)), formatting);
+    }
+
+    /** views::base64_encode(true) adds MIME line endings */
+    base64_encode_closure operator()(bool formatting) const { return { formatting }; }
+
+    template <std::ranges::viewable_range R>
+    friend auto operator|(R &&r, const base64_encode_fn &)
+    {
+        return base64_encode_view(std::views::all(std::forward<R>(r)), false);
+    }
+};
+
+struct base64_decode_fn
+{
+    template <std::ranges::viewable_range R>
+    auto operator()(R &&r) const
+    {
+        return base64_decode_view(std::views::all(std::forward<R>(r)));
+    }
+
+    template <std::ranges::viewable_range R>
+    friend auto operator|(R &&r, const base64_decode_fn &)
+    {
+        return base64_decode_view(std::views::all(std::forward<R>(r)));
+    }
+};
+
+} // namespace detail
+
+inline constexpr detail::base64_encode_fn base64_encode{};
+inline constexpr detail::base64_decode_fn base64_decode{};
+
+} // namespace views
+
+} // namespace mig
+
+#endif
@@ -19,7 +19,15 @@
 #define kB64InsufficientMemory      @"NotEnoughMemory"       // Failed to allocate buffer space
 #define kB64UnknownError            @"UnknownError"          // Unknown error
 
+#pragma mark -
+#pragma mark NSError userInfo keys
+
+#define kB64ErrorOffsetKey          @"MIGBase64ErrorOffset"  // NSNumber byte offset of the failure within the input
+
 
 NSError *generateErrorStructure(MIG_Result res);
 
+/** As generateErrorStructure, additionally surfacing the failure offset (kB64ErrorOffsetKey) */
+NSError *generateErrorStructureWithDetail(MIG_ErrorDetail detail);
+
 #endif
@@ -27,6 +27,26 @@ NSError *generateErrorStructure(MIG_Result res)
         [details setValue:NSLocalizedString(@"Unable to allocate buffer for result", nil) forKey:NSLocalizedDescriptionKey];
         return [NSError errorWithDomain:kB64InsufficientMemory code:MIG_NoMemory userInfo:details];
     }
+    else if (res == MIG_Base64IllegalCharacter)
+    {
+        [details setValue:NSLocalizedString(@"Base64 encoding contains an illegal character", nil) forKey:NSLocalizedDescriptionKey];
+        return [NSError errorWithDomain:kB64IncorrectEncoding code:MIG_Base64IllegalCharacter userInfo:details];
+    }
+    else if (res == MIG_Base64PaddingInvalid)
+    {
+        [details setValue:NSLocalizedString(@"Base64 encoding padding is misplaced", nil) forKey:NSLocalizedDescriptionKey];
+        return [NSError errorWithDomain:kB64IncorrectEncoding code:MIG_Base64PaddingInvalid userInfo:details];
+    }
+    else if (res == MIG_Base64Truncated)
+    {
+        [details setValue:NSLocalizedString(@"Base64 encoding is truncated", nil) forKey:NSLocalizedDescriptionKey];
+        return [NSError errorWithDomain:kB64IncorrectEncoding code:MIG_Base64Truncated userInfo:details];
+    }
+    else if (res == MIG_OutputTooSmall)
+    {
+        [details setValue:NSLocalizedString(@"Output buffer too small for result", nil) forKey:NSLocalizedDescriptionKey];
+        return [NSError errorWithDomain:kB64InsufficientMemory code:MIG_OutputTooSmall userInfo:details];
+    }
     else if (res == MIG_Base64StringEmpty)
     {
         [details setValue:NSLocalizedString(@"Base64 input string empty", nil) forKey:NSLocalizedDescriptionKey];
@@ -39,4 +59,21 @@ NSError *generateErrorStructure(MIG_Result res)
     }
 }
 
+NSError *generateErrorStructureWithDetail(MIG_ErrorDetail detail)
+{
+    NSError *error = generateErrorStructure(detail.result);
+    if (detail.result != MIG_Base64IllegalCharacter &&
+        detail.result != MIG_Base64PaddingInvalid &&
+        detail.result != MIG_Base64Truncated)
+    {
+        // No meaningful offset for this failure
+        return error;
+    }
+    
+    NSMutableDictionary *details = [error.userInfo mutableCopy];
+    [details setValue:[NSNumber numberWithUnsignedInt:detail.offset] forKey:kB64ErrorOffsetKey];
+    [details setValue:[NSString stringWithFormat:@"%@ (offset %u)", error.localizedDescription, detail.offset] forKey:NSLocalizedDescriptionKey];
+    return [NSError errorWithDomain:error.domain code:error.code userInfo:details];
+}
+
 
@@ -84,6 +84,8 @@
 
 #include <stdio.h>
 #include "stdlib.h"
+#include <string.h>
+#include <limits.h>
 
 #include "MIGConverter.h"
 
@@ -107,52 +109,283 @@ static int IA[256] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
 };
 
+#pragma mark -
+#pragma mark Lenient decode helpers
 
-/** Encodes a raw byte array into a BASE64 <code>char[]</code> representation i accordance with RFC 2045.
- * No line separator will be in breach of RFC 2045 which specifies max 76 per line but will be a
- * little faster.
- * @return A BASE64 encoded array. Never <code>null</code>.
- */
+/* When SSSE3 is available the lenient decoder classifies and translates 16 characters at a time,
+   compacts the illegal characters (line separators, whitespace, escapes etc.) out of the block
+   in-register and decodes whole quanta 16 characters (12 bytes) at a time.  Without SSSE3 the
+   helpers fall back to the original character-at-a-time loops. */
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define MIG_USE_SSSE3 1
+#endif
 
+#if MIG_USE_SSSE3
 
-MIG_Result MIG_encodeAsBase64(int useOptionalLineEndings,
-                              const unsigned char *sArr,
-                              unsigned int sLen,
-                              char **result,
-                              unsigned int *resultLen)
+/* pshufb masks that move the legal characters of an 8 byte lane to the front of the lane.
+   Indexed by the bitmask of legal characters within the lane.  Unused slots are 0x80 (zero). */
+static const unsigned long long MIG_compactTable[256] = {
+    0x8080808080808080ULL, 0x8080808080808000ULL, 0x8080808080808001ULL, 0x8080808080800100ULL,
+    0x8080808080808002ULL, 0x8080808080800200ULL, 0x8080808080800201ULL, 0x8080808080020100ULL,
+    0x8080808080808003ULL, 0x8080808080800300ULL, 0x8080808080800301ULL, 0x8080808080030100ULL,
+    0x8080808080800302ULL, 0x8080808080030200ULL, 0x8080808080030201ULL, 0x8080808003020100ULL,
+    0x8080808080808004ULL, 0x8080808080800400ULL, 0x8080808080800401ULL, 0x8080808080040100ULL,
+    0x8080808080800402ULL, 0x8080808080040200ULL, 0x8080808080040201ULL, 0x8080808004020100ULL,
+    0x8080808080800403ULL, 0x8080808080040300ULL, 0x8080808080040301ULL, 0x8080808004030100ULL,
+    0x8080808080040302ULL, 0x8080808004030200ULL, 0x8080808004030201ULL, 0x8080800403020100ULL,
+    0x8080808080808005ULL, 0x8080808080800500ULL, 0x8080808080800501ULL, 0x8080808080050100ULL,
+    0x8080808080800502ULL, 0x8080808080050200ULL, 0x8080808080050201ULL, 0x8080808005020100ULL,
+    0x8080808080800503ULL, 0x8080808080050300ULL, 0x8080808080050301ULL, 0x8080808005030100ULL,
+    0x8080808080050302ULL, 0x8080808005030200ULL, 0x8080808005030201ULL, 0x8080800503020100ULL,
+    0x8080808080800504ULL, 0x8080808080050400ULL, 0x8080808080050401ULL, 0x8080808005040100ULL,
+    0x8080808080050402ULL, 0x8080808005040200ULL, 0x8080808005040201ULL, 0x8080800504020100ULL,
+    0x8080808080050403ULL, 0x8080808005040300ULL, 0x8080808005040301ULL, 0x8080800504030100ULL,
+    0x8080808005040302ULL, 0x8080800504030200ULL, 0x8080800504030201ULL, 0x8080050403020100ULL,
+    0x8080808080808006ULL, 0x8080808080800600ULL, 0x8080808080800601ULL, 0x8080808080060100ULL,
+    0x8080808080800602ULL, 0x8080808080060200ULL, 0x8080808080060201ULL, 0x8080808006020100ULL,
+    0x8080808080800603ULL, 0x8080808080060300ULL, 0x8080808080060301ULL, 0x8080808006030100ULL,
+    0x8080808080060302ULL, 0x8080808006030200ULL, 0x8080808006030201ULL, 0x8080800603020100ULL,
+    0x8080808080800604ULL, 0x8080808080060400ULL, 0x8080808080060401ULL, 0x8080808006040100ULL,
+    0x8080808080060402ULL, 0x8080808006040200ULL, 0x8080808006040201ULL, 0x8080800604020100ULL,
+    0x8080808080060403ULL, 0x8080808006040300ULL, 0x8080808006040301ULL, 0x8080800604030100ULL,
+    0x8080808006040302ULL, 0x8080800604030200ULL, 0x8080800604030201ULL, 0x8080060403020100ULL,
+    0x8080808080800605ULL, 0x8080808080060500ULL, 0x8080808080060501ULL, 0x8080808006050100ULL,
+    0x8080808080060502ULL, 0x8080808006050200ULL, 0x8080808006050201ULL, 0x8080800605020100ULL,
+    0x8080808080060503ULL, 0x8080808006050300ULL, 0x8080808006050301ULL, 0x8080800605030100ULL,
+    0x8080808006050302ULL, 0x8080800605030200ULL, 0x8080800605030201ULL, 0x8080060503020100ULL,
+    0x8080808080060504ULL, 0x8080808006050400ULL, 0x8080808006050401ULL, 0x8080800605040100ULL,
+    0x8080808006050402ULL, 0x8080800605040200ULL, 0x8080800605040201ULL, 0x8080060504020100ULL,
+    0x8080808006050403ULL, 0x8080800605040300ULL, 0x8080800605040301ULL, 0x8080060504030100ULL,
+    0x8080800605040302ULL, 0x8080060504030200ULL, 0x8080060504030201ULL, 0x8006050403020100ULL,
+    0x8080808080808007ULL, 0x8080808080800700ULL, 0x8080808080800701ULL, 0x8080808080070100ULL,
+    0x8080808080800702ULL, 0x8080808080070200ULL, 0x8080808080070201ULL, 0x8080808007020100ULL,
+    0x8080808080800703ULL, 0x8080808080070300ULL, 0x8080808080070301ULL, 0x8080808007030100ULL,
+    0x8080808080070302ULL, 0x8080808007030200ULL, 0x8080808007030201ULL, 0x8080800703020100ULL,
+    0x8080808080800704ULL, 0x8080808080070400ULL, 0x8080808080070401ULL, 0x8080808007040100ULL,
+    0x8080808080070402ULL, 0x8080808007040200ULL, 0x8080808007040201ULL, 0x8080800704020100ULL,
+    0x8080808080070403ULL, 0x8080808007040300ULL, 0x8080808007040301ULL, 0x8080800704030100ULL,
+    0x8080808007040302ULL, 0x8080800704030200ULL, 0x8080800704030201ULL, 0x8080070403020100ULL,
+    0x8080808080800705ULL, 0x8080808080070500ULL, 0x8080808080070501ULL, 0x8080808007050100ULL,
+    0x8080808080070502ULL, 0x8080808007050200ULL, 0x8080808007050201ULL, 0x8080800705020100ULL,
+    0x8080808080070503ULL, 0x8080808007050300ULL, 0x8080808007050301ULL, 0x8080800705030100ULL,
+    0x8080808007050302ULL, 0x8080800705030200ULL, 0x8080800705030201ULL, 0x8080070503020100ULL,
+    0x8080808080070504ULL, 0x8080808007050400ULL, 0x8080808007050401ULL, 0x8080800705040100ULL,
+    0x8080808007050402ULL, 0x8080800705040200ULL, 0x8080800705040201ULL, 0x8080070504020100ULL,
+    0x8080808007050403ULL, 0x8080800705040300ULL, 0x8080800705040301ULL, 0x8080070504030100ULL,
+    0x8080800705040302ULL, 0x8080070504030200ULL, 0x8080070504030201ULL, 0x8007050403020100ULL,
+    0x8080808080800706ULL, 0x8080808080070600ULL, 0x8080808080070601ULL, 0x8080808007060100ULL,
+    0x8080808080070602ULL, 0x8080808007060200ULL, 0x8080808007060201ULL, 0x8080800706020100ULL,
+    0x8080808080070603ULL, 0x8080808007060300ULL, 0x8080808007060301ULL, 0x8080800706030100ULL,
+    0x8080808007060302ULL, 0x8080800706030200ULL, 0x8080800706030201ULL, 0x8080070603020100ULL,
+    0x8080808080070604ULL, 0x8080808007060400ULL, 0x8080808007060401ULL, 0x8080800706040100ULL,
+    0x8080808007060402ULL, 0x8080800706040200ULL, 0x8080800706040201ULL, 0x8080070604020100ULL,
+    0x8080808007060403ULL, 0x8080800706040300ULL, 0x8080800706040301ULL, 0x8080070604030100ULL,
+    0x8080800706040302ULL, 0x8080070604030200ULL, 0x8080070604030201ULL, 0x8007060403020100ULL,
+    0x8080808080070605ULL, 0x8080808007060500ULL, 0x8080808007060501ULL, 0x8080800706050100ULL,
+    0x8080808007060502ULL, 0x8080800706050200ULL, 0x8080800706050201ULL, 0x8080070605020100ULL,
+    0x8080808007060503ULL, 0x8080800706050300ULL, 0x8080800706050301ULL, 0x8080070605030100ULL,
+    0x8080800706050302ULL, 0x8080070605030200ULL, 0x8080070605030201ULL, 0x8007060503020100ULL,
+    0x8080808007060504ULL, 0x8080800706050400ULL, 0x8080800706050401ULL, 0x8080070605040100ULL,
+    0x8080800706050402ULL, 0x8080070605040200ULL, 0x8080070605040201ULL, 0x8007060504020100ULL,
+    0x8080800706050403ULL, 0x8080070605040300ULL, 0x8080070605040301ULL, 0x8007060504030100ULL,
+    0x8080070605040302ULL, 0x8007060504030200ULL, 0x8007060504030201ULL, 0x0706050403020100ULL,
+};
+
+/* Translates 16 characters into their 6-bit values using nibble lookups.  On return 'illegal'
+   has a bit set for every character that is not part of the Base64 alphabet.  As with the IA
+   table, '=' is a legal character with a value of 0. */
+static inline __m128i MIG_translate16(__m128i v, unsigned int *illegal)
 {
-    /* Check special case */
-    if (sArr == NULL)
+    const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71,
+                                          0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    
+    __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(v, 4), nibble);
+    __m128i loNibbles = _mm_and_si128(v, nibble);
+    __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+    __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+    __m128i isPad = _mm_cmpeq_epi8(v, _mm_set1_epi8('='));
+    __m128i isLegal = _mm_or_si128(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128()), isPad);
+    *illegal = ~_mm_movemask_epi8(isLegal) & 0xffff;
+    
+    __m128i isSlash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+    __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(isSlash, hiNibbles));
+    return _mm_andnot_si128(isPad, _mm_add_epi8(v, roll));
+}
+
+/* Packs 16 6-bit values (four quanta) into 12 bytes at the bottom of the register. */
+static inline __m128i MIG_pack16(__m128i values)
+{
+    __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+/* pshufb masks for variable byte shifts.  Loading 16 bytes at (16 - n) shifts a register up by
+   n bytes, loading at (16 + n) shifts it down by n bytes, zero filling in both cases. */
+static const unsigned char MIG_shiftTable[48] = {
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+
+static inline __m128i MIG_shiftUp(__m128i v, unsigned int n)
+{
+    return _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i *)(MIG_shiftTable + 16 - n)));
+}
+
+static inline __m128i MIG_shiftDown(__m128i v, unsigned int n)
+{
+    return _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i *)(MIG_shiftTable + 16 + n)));
+}
+
+/* Moves the legal values of a block to the bottom of the register, returning their count in 'cnt'. */
+static inline __m128i MIG_compact16(__m128i values, unsigned int legal, unsigned int *cnt)
+{
+    const __m128i upperZero = _mm_setr_epi32(0, 0, (int)0x80808080, (int)0x80808080);
+    __m128i lo = _mm_or_si128(_mm_loadl_epi64((const __m128i *)&MIG_compactTable[legal & 0xff]), upperZero);
+    __m128i hi = _mm_or_si128(_mm_loadl_epi64((const __m128i *)&MIG_compactTable[legal >> 8]), upperZero);
+    unsigned int loCnt = __builtin_popcount(legal & 0xff);
+    
+    *cnt = loCnt + __builtin_popcount(legal >> 8);
+    return _mm_or_si128(_mm_shuffle_epi8(values, lo),
+                        MIG_shiftUp(_mm_shuffle_epi8(_mm_srli_si128(values, 8), hi), loCnt));
+}
+
+#endif
+
+/* Returns the number of characters in 'sArr' that are not legal Base64 characters. */
+static unsigned int MIG_countIllegal(const char *sArr, unsigned int sLen)
+{
+    unsigned int sepCnt = 0, s = 0;
+#if MIG_USE_SSSE3
+    for (; s + 16 <= sLen; s += 16)
     {
-        /* Special case -- shouldn't deal with it */
-        return MIG_InputDataEmpty;
+        unsigned int illegal;
+        MIG_translate16(_mm_loadu_si128((const __m128i *)(sArr + s)), &illegal);
+        sepCnt += __builtin_popcount(illegal);
     }
-    else if (sLen == 0)
+#endif
+    for (; s < sLen; s++)
     {
-        /* Empty string -- return empty string according to RFC */
-        *result = (char *)calloc(1, sizeof(char));
-        *resultLen = 0;
-        return MIG_OK;
+        if (IA[sArr[s] & 0xff] < 0)
+            sepCnt++;
     }
-    
-    int eLen = (sLen / 3) * 3;              /* Length of even 24-bits. */
-    int cCnt = ((sLen - 1) / 3 + 1) << 2;   /* Returned character count */
-    int dLen = cCnt + ((useOptionalLineEndings==1) ? (cCnt - 1) / 76 << 1 : 0); /* Length of returned array */
+    return sepCnt;
+}
 
-    /* Create the storage array.  When complete, the array will become contained
-       within the returned NSString object, so it will be freed when the result
-       object is released. */
-    char *dArr = (char *)calloc(dLen, sizeof(char));
-    if (dArr == NULL)
+/* Decodes the legal characters in 'sArr' into 'dArr', ignoring every illegal character.
+   'dLen' is the decoded length computed from the legal character and padding counts. */
+static void MIG_decodeLegal(const char *sArr, unsigned int sLen, unsigned char *dArr, unsigned int dLen)
+{
+    unsigned int s = 0, d = 0;
+    unsigned char staged[32];       /* Translated values not yet decoded by the vector loop */
+    unsigned int stagedCnt = 0, k = 0;
+    
+#if MIG_USE_SSSE3
+    __m128i acc = _mm_setzero_si128();  /* Partial block of translated values */
+    unsigned int accCnt = 0;
+    
+    while (s + 16 <= sLen)
     {
-        return MIG_NoMemory;
+        unsigned int illegal, cnt = 16;
+        __m128i values = MIG_translate16(_mm_loadu_si128((const __m128i *)(sArr + s)), &illegal);
+        s += 16;
+        
+        /* Squeeze out the illegal characters */
+        if (illegal != 0)
+            values = MIG_compact16(values, ~illegal & 0xffff, &cnt);
+        
+        if (accCnt + cnt < 16)
+        {
+            acc = _mm_or_si128(acc, MIG_shiftUp(values, accCnt));
+            accCnt += cnt;
+            continue;
+        }
+        
+        __m128i full = _mm_or_si128(acc, MIG_shiftUp(values, accCnt));
+        __m128i rest = MIG_shiftDown(values, 16 - accCnt);
+        accCnt = accCnt + cnt - 16;
+        
+        /* The padded tail is left to the character-at-a-time loop below */
+        if (d + 12 > dLen)
+        {
+            _mm_storeu_si128((__m128i *)staged, full);
+            _mm_storeu_si128((__m128i *)(staged + 16), rest);
+            stagedCnt = 16 + accCnt;
+            break;
+        }
+        
+        __m128i bytes = MIG_pack16(full);
+        if (d + 16 <= dLen)
+        {
+            _mm_storeu_si128((__m128i *)(dArr + d), bytes);
+        }
+        else
+        {
+            unsigned char tmp[16];
+            _mm_storeu_si128((__m128i *)tmp, bytes);
+            memcpy(dArr + d, tmp, 12);
+        }
+        d += 12;
+        acc = rest;
+    }
+    
+    if (stagedCnt == 0)
+    {
+        _mm_storeu_si128((__m128i *)staged, acc);
+        stagedCnt = accCnt;
+    }
+#endif
+    
+    while (d < dLen)
+    {
+        /* Assemble three bytes into an int from four "valid" characters, staged values first. */
+        int i = 0, j = 0;
+        for (; j < 4 && k < stagedCnt; j++)
+            i |= staged[k++] << (18 - j * 6);
+        
+        for (; j < 4 && s < sLen; s++)
+        {
+            /* j only increased if a valid char was found. */
+            int c = IA[sArr[s] & 0xff];
+            if (c >= 0)
+                i |= c << (18 - j++ * 6);
+        }
+        
+        /* Add the bytes */
+        dArr[d++] = (unsigned char) (i >> 16);
+        if (d < dLen)
+        {
+            dArr[d++] = (unsigned char) (i >> 8);
+            if (d < dLen)
+            {
+                dArr[d++] = (unsigned char) i;
+            }
+        }
     }
+}
+
+
+/* Encodes 'sArr' into 'dArr', which must be exactly MIG_encodedLength() chars long */
+static void MIG_encodeTo(int useOptionalLineEndings,
+                         const unsigned char *sArr,
+                         unsigned int sLen,
+                         char *dArr,
+                         int dLen)
+{
+    int eLen = (sLen / 3) * 3;              /* Length of even 24-bits. */
     
     /* Encode even 24-bits */
-    for (int s = 0, d = 0, cc = 0; s < eLen;)
+    for (int s = 0, d = 0, cc = 0; s < eLen; s += 3)
     {
         /* Copy next three bytes into lower 24 bits of int, paying attension to sign. */
-        int i = (sArr[s++] & 0xff) << 16 | (sArr[s++] & 0xff) << 8 | (sArr[s++] & 0xff);
+        int i = (sArr[s] & 0xff) << 16 | (sArr[s + 1] & 0xff) << 8 | (sArr[s + 2] & 0xff);
         
         /* Encode the int into four chars */
         dArr[d++] = CA[(i >> 18) & 0x3f];
@@ -182,49 +415,103 @@ MIG_Result MIG_encodeAsBase64(int useOptionalLineEndings,
         dArr[dLen - 2] = left == 2 ? CA[i & 0x3f] : '=';
         dArr[dLen - 1] = '=';
     }
+}
 
-    *result = dArr;
-    *resultLen = dLen;
+unsigned int MIG_encodedLength(int useOptionalLineEndings,
+                               unsigned int sLen)
+{
+    if (sLen == 0)
+    {
+        return 0;
+    }
     
-    return MIG_OK;
+    int cCnt = ((sLen - 1) / 3 + 1) << 2;   /* Returned character count */
+    return cCnt + ((useOptionalLineEndings==1) ? (cCnt - 1) / 76 << 1 : 0);
 }
 
-/** Decodes a BASE64 encoded char array. All illegal characters will be ignored and can handle both arrays with
- * and without line separators.
- * @param sArr The source array. <code>null</code> or length 0 will return an empty array.
- * @return The decoded array of bytes. May be of length 0. Will be <code>null</code> if the legal characters
- * (including '=') isn't divideable by 4.  (I.e. definitely corrupted).
+/** Encodes a raw byte array into a BASE64 <code>char[]</code> representation i accordance with RFC 2045.
+ * No line separator will be in breach of RFC 2045 which specifies max 76 per line but will be a
+ * little faster.
+ * @return A BASE64 encoded array. Never <code>null</code>.
  */
 
-MIG_Result MIG_decodeAsBase64(const char *sArr,
+
+MIG_Result MIG_encodeAsBase64(int useOptionalLineEndings,
+                              const unsigned char *sArr,
                               unsigned int sLen,
-                              unsigned char **result,
+                              char **result,
                               unsigned int *resultLen)
 {
+    /* Check special case */
     if (sArr == NULL)
     {
-        return MIG_Base64StringEmpty;
+        /* Special case -- shouldn't deal with it */
+        return MIG_InputDataEmpty;
     }
     else if (sLen == 0)
     {
         /* Empty string -- return empty string according to RFC */
-        *result = (unsigned char *)calloc(1, sizeof(unsigned char));
+        *result = (char *)calloc(1, sizeof(char));
         *resultLen = 0;
         return MIG_OK;
     }
     
-    /* Count illegal characters (including '\r', '\n') to know what size the returned array will be,
-       so we don't have to reallocate & copy it later. */
-    int sepCnt = 0; /* Number of separator characters. (Actually illegal characters, but that's a bonus...) */
-    for (int i = 0; i < sLen; i++)  /* If input is "pure" (I.e. no line separators or illegal chars) base64 this loop can be commented out. */
+    int dLen = MIG_encodedLength(useOptionalLineEndings, sLen); /* Length of returned array */
+
+    /* Create the storage array.  When complete, the array will become contained
+       within the returned NSString object, so it will be freed when the result
+       object is released. */
+    char *dArr = (char *)calloc(dLen, sizeof(char));
+    if (dArr == NULL)
     {
-        char c = sArr[i];
-        if (IA[c] < 0)
-        {
-            sepCnt++;
-        }
+        return MIG_NoMemory;
+    }
+    
+    MIG_encodeTo(useOptionalLineEndings, sArr, sLen, dArr, dLen);
+
+    *result = dArr;
+    *resultLen = dLen;
+    
+    return MIG_OK;
+}
+
+MIG_Result MIG_encodeAsBase64Into(int useOptionalLineEndings,
+                                  const unsigned char *sArr,
+                                  unsigned int sLen,
+                                  char *dArr,
+                                  unsigned int dLen,
+                                  unsigned int *resultLen)
+{
+    if (sArr == NULL)
+    {
+        return MIG_InputDataEmpty;
+    }
+    
+    unsigned int eLen = MIG_encodedLength(useOptionalLineEndings, sLen);
+    if (dLen < eLen)
+    {
+        return MIG_OutputTooSmall;
+    }
+    
+    MIG_encodeTo(useOptionalLineEndings, sArr, sLen, dArr, eLen);
+    *resultLen = eLen;
+    
+    return MIG_OK;
+}
+
+MIG_Result MIG_decodedLength(const char *sArr,
+                             unsigned int sLen,
+                             unsigned int *resultLen)
+{
+    if (sArr == NULL)
+    {
+        return MIG_Base64StringEmpty;
     }
     
+    /* Count illegal characters (including '\r', '\n') to know what size the returned array will be,
+       so we don't have to reallocate & copy it later. */
+    int sepCnt = MIG_countIllegal(sArr, sLen); /* Number of separator characters. (Actually illegal characters, but that's a bonus...) */
+    
     /* Check so that legal chars (including '=') are evenly divideable by 4 as specified in RFC 2045. */
     if ((sLen - sepCnt) % 4 != 0)
     {
@@ -232,72 +519,40 @@ MIG_Result MIG_decodeAsBase64(const char *sArr,
     }
     
     int pad = 0;
-    for (int i = sLen; i > 1 && IA[sArr[--i]] <= 0;)
+    for (int i = sLen; i > 1 && IA[sArr[--i] & 0xff] <= 0;)
     {
         char c = sArr[i];
         if (c == '=')
             pad++;
     }
     
-    int dLen = ((sLen - sepCnt) * 6 >> 3) - pad;
-    
-    unsigned char *dArr = (unsigned char *)calloc(dLen, sizeof(unsigned char));
-    if (dArr == NULL)
-    {
-        return MIG_NoMemory;
-    }
-    
-    for (int s = 0, d = 0; d < dLen;)
+    /* At most two '=', and never more than the data they pad (eg. "========" or "A=======") */
+    unsigned int legalLen = (sLen - sepCnt) * 6 >> 3;
+    if (pad > 2 || (unsigned int)pad > legalLen)
     {
-        /* Assemble three bytes into an int from four "valid" characters. */
-        int i = 0;
-        for (int j = 0; j < 4; j++, s++)
-        {
-            /* j only increased if a valid char was found. */
-            char r = sArr[s];
-            int c = IA[r];
-            if (c >= 0)
-                i |= c << (18 - j * 6);
-            else
-                j--;
-        }
-        /* Add the bytes */
-        dArr[d++] = (unsigned char) (i >> 16);
-        if (d < dLen)
-        {
-            dArr[d++] = (unsigned char) (i >> 8);
-            if (d < dLen)
-            {
-                dArr[d++] = (unsigned char) i;
-            }
-        }
+        return MIG_Base64EncodingInvalid;
     }
     
-    *result = dArr;
-    *resultLen = dLen;
+    *resultLen = legalLen - pad;
     
     return MIG_OK;
 }
 
-
-/** Decodes a BASE64 encoded byte array that is known to be resonably well formatted. The method is about twice as
- * fast as {@link #decode(byte[])}. The preconditions are:<br>
- * + The array must have a line length of 76 chars OR no line separators at all (one line).<br>
- * + Line separator must be "\r\n", as specified in RFC 2045
- * + The array must not contain illegal characters within the encoded string<br>
- * + The array CAN have illegal characters at the beginning and end, those will be dealt with appropriately.<br>
- * @param sArr The source array. Length 0 will return an empty array. <code>null</code> will throw an exception.
- * @return The decoded array of bytes. May be of length 0.
+/** Decodes a BASE64 encoded char array. All illegal characters will be ignored and can handle both arrays with
+ * and without line separators.
+ * @param sArr The source array. <code>null</code> or length 0 will return an empty array.
+ * @return The decoded array of bytes. May be of length 0. Will be <code>null</code> if the legal characters
+ * (including '=') isn't divideable by 4.  (I.e. definitely corrupted).
  */
-MIG_Result MIG_decodeAsBase64Fast(const char *sArr,
-                                  unsigned int sLen,
-                                  unsigned char **result,
-                                  unsigned int *resultLen)
+
+MIG_Result MIG_decodeAsBase64(const char *sArr,
+                              unsigned int sLen,
+                              unsigned char **result,
+                              unsigned int *resultLen)
 {
-    /* Check special case */
     if (sArr == NULL)
     {
-        return MIG_InputDataEmpty;
+        return MIG_Base64StringEmpty;
     }
     else if (sLen == 0)
     {
@@ -307,35 +562,254 @@ MIG_Result MIG_decodeAsBase64Fast(const char *sArr,
         return MIG_OK;
     }
     
-    int sIx = 0, eIx = sLen - 1;    /* Start and end index after trimming. */
+    unsigned int dLen;
+    MIG_Result res = MIG_decodedLength(sArr, sLen, &dLen);
+    if (res != MIG_OK)
+    {
+        return res;
+    }
     
-    /* Trim illegal chars from start */
-    while (sIx < eIx && IA[sArr[sIx] & 0xff] < 0)
-        sIx++;
+    unsigned char *dArr = (unsigned char *)calloc(dLen, sizeof(unsigned char));
+    if (dArr == NULL)
+    {
+        return MIG_NoMemory;
+    }
     
-    /* Trim illegal chars from end */
-    while (eIx > 0 && IA[sArr[eIx] & 0xff] < 0)
-        eIx--;
+    MIG_decodeLegal(sArr, sLen, dArr, dLen);
     
-    /* get the padding count (=) (0, 1 or 2) */
-    int pad = sArr[eIx] == '=' ? (sArr[eIx - 1] == '=' ? 2 : 1) : 0;  /* Count '=' at end. */
-    int cCnt = eIx - sIx + 1;   /* Content count including possible separators */
-    int sepCnt = sLen > 76 ? (sArr[76] == '\r' ? cCnt / 78 : 0) << 1 : 0;
+    *result = dArr;
+    *resultLen = dLen;
     
-    int dLen = ((cCnt - sepCnt) * 6 >> 3) - pad; /* The number of decoded bytes */
+    return MIG_OK;
+}
 
-    unsigned char *dArr = (unsigned char *)calloc(dLen, sizeof(unsigned char));
-    if (dArr == NULL)
+
+MIG_Result MIG_decodeAsBase64Into(const char *sArr,
+                                  unsigned int sLen,
+                                  unsigned char *dArr,
+                                  unsigned int dLen)
+{
+    if (sArr == NULL)
     {
-        return MIG_NoMemory;
+        return MIG_Base64StringEmpty;
     }
     
-    /* Decode all but the last 0 - 2 bytes. */
-    int d = 0;
-    for (int cc = 0, eLen = (dLen / 3) * 3; d < eLen;)
+    MIG_decodeLegal(sArr, sLen, dArr, dLen);
+    
+    return MIG_OK;
+}
+
+unsigned int MIG_legalLength(const char *sArr,
+                             unsigned int sLen)
+{
+    return sLen - MIG_countIllegal(sArr, sLen);
+}
+
+unsigned int MIG_decodableLength(const char *sArr,
+                                 unsigned int sLen,
+                                 char *carry,
+                                 unsigned int *carryLen)
+{
+    unsigned int rem = (sLen - MIG_countIllegal(sArr, sLen)) & 3;   /* Legal chars of the partial quantum */
+    unsigned int e = sLen, c = 0;
+    
+    /* Step back over the partial quantum to just after the last legal char of the last whole quantum */
+    for (unsigned int n = rem; e > 0 && (n > 0 || IA[sArr[e - 1] & 0xff] < 0); e--)
     {
-        /* Assemble three bytes into an int from four "valid" characters. */
-        int i = IA[sArr[sIx++]] << 18 | IA[sArr[sIx++]] << 12 | IA[sArr[sIx++]] << 6 | IA[sArr[sIx++]];
+        if (IA[sArr[e - 1] & 0xff] >= 0)
+            n--;
+    }
+    
+    /* Keep the legal chars of the partial quantum, for the front of the next block */
+    for (unsigned int s = e; s < sLen && c < rem; s++)
+    {
+        if (IA[sArr[s] & 0xff] >= 0)
+            carry[c++] = sArr[s];
+    }
+    
+    *carryLen = c;
+    return e;
+}
+
+void MIG_trackPadding(const char *sArr,
+                      unsigned int sLen,
+                      int streamStart,
+                      unsigned int *pad)
+{
+    /* As MIG_decodedLength, walk back over the chars carrying no data bits ('=', 'A' and illegal chars),
+       never looking at the very first char of the stream */
+    unsigned int first = streamStart ? 1 : 0;
+    unsigned int i = sLen, cnt = 0;
+    for (; i > first && IA[sArr[i - 1] & 0xff] <= 0; i--)
+    {
+        if (sArr[i - 1] == '=' && cnt < 3)
+            cnt++;
+    }
+    
+    /* A data char ends the run within this block, otherwise it carries on from the previous blocks.
+       Anything past 2 is invalid, so the count saturates at 3 rather than wraps */
+    unsigned int total = (i > first) ? cnt : *pad + cnt;
+    *pad = total > 3 ? 3 : total;
+}
+
+/** Decodes a BASE64 encoded char array, rejecting anything that isn't strictly well formed.
+ * Only the alphabet, '=' and line separators ("\r", "\n") are accepted. '=' may only fill the last one or
+ * two positions of the final quantum. Validation happens before any memory is allocated and stops at the
+ * first offending character, whose offset is reported through 'detail'.
+ */
+MIG_Result MIG_decodeAsBase64Strict(const char *sArr,
+                                    unsigned int sLen,
+                                    unsigned char **result,
+                                    unsigned int *resultLen,
+                                    MIG_ErrorDetail *detail)
+{
+    MIG_ErrorDetail ignored;
+    if (detail == NULL)
+    {
+        detail = &ignored;
+    }
+    detail->result = MIG_OK;
+    detail->offset = 0;
+    
+    if (sArr == NULL)
+    {
+        detail->result = MIG_Base64StringEmpty;
+        return MIG_Base64StringEmpty;
+    }
+    else if (sLen == 0)
+    {
+        /* Empty string -- return empty string according to RFC */
+        *result = (unsigned char *)calloc(1, sizeof(unsigned char));
+        *resultLen = 0;
+        return MIG_OK;
+    }
+    
+    unsigned int legal = 0, pad = 0, s = 0;
+    while (s < sLen)
+    {
+        unsigned int e = sLen;
+#if MIG_USE_SSSE3
+        /* A block of alphabet characters is always well placed until padding has been seen */
+        if (pad == 0 && s + 16 <= sLen)
+        {
+            unsigned int illegal;
+            __m128i v = _mm_loadu_si128((const __m128i *)(sArr + s));
+            MIG_translate16(v, &illegal);
+            if (illegal == 0 && _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('='))) == 0)
+            {
+                legal += 16;
+                s += 16;
+                continue;
+            }
+            e = s + 16;
+        }
+#endif
+        for (; s < e; s++)
+        {
+            char c = sArr[s];
+            if (c == '=')
+            {
+                /* Padding may only fill the last one or two positions of a quantum */
+                if ((legal & 3) < 2)
+                {
+                    detail->result = MIG_Base64PaddingInvalid;
+                    detail->offset = s;
+                    return MIG_Base64PaddingInvalid;
+                }
+                pad++;
+                legal++;
+            }
+            else if (IA[c & 0xff] >= 0)
+            {
+                /* Nothing but separators may follow the padding */
+                if (pad > 0)
+                {
+                    detail->result = MIG_Base64PaddingInvalid;
+                    detail->offset = s;
+                    return MIG_Base64PaddingInvalid;
+                }
+                legal++;
+            }
+            else if (c != '\r' && c != '\n')
+            {
+                detail->result = MIG_Base64IllegalCharacter;
+                detail->offset = s;
+                return MIG_Base64IllegalCharacter;
+            }
+        }
+    }
+    
+    if ((legal & 3) != 0)
+    {
+        detail->result = MIG_Base64Truncated;
+        detail->offset = sLen;
+        return MIG_Base64Truncated;
+    }
+    
+    unsigned int dLen = (legal >> 2) * 3 - pad;
+    
+    unsigned char *dArr = (unsigned char *)calloc(dLen > 0 ? dLen : 1, sizeof(unsigned char));
+    if (dArr == NULL)
+    {
+        detail->result = MIG_NoMemory;
+        return MIG_NoMemory;
+    }
+    
+    MIG_decodeLegal(sArr, sLen, dArr, dLen);
+    
+    *result = dArr;
+    *resultLen = dLen;
+    
+    return MIG_OK;
+}
+
+
+/* Trims the illegal characters at either end of 'sArr' and lays out its content for the fast decoder.
+   Returns the decoded length (0 if there's no content). */
+static int MIG_fastLayout(const char *sArr, unsigned int sLen, int *sIx, int *eIx, int *pad, int *sepCnt)
+{
+    int s = 0, e = sLen - 1;    /* Start and end index after trimming. */
+    
+    /* Trim illegal chars from start */
+    while (s < e && IA[sArr[s] & 0xff] < 0)
+        s++;
+    
+    /* Trim illegal chars from end */
+    while (e > 0 && IA[sArr[e] & 0xff] < 0)
+        e--;
+    
+    if (e < s || IA[sArr[e] & 0xff] < 0)
+    {
+        /* Nothing but illegal chars */
+        *sIx = *eIx = *pad = *sepCnt = 0;
+        return 0;
+    }
+    
+    /* get the padding count (=) (0, 1 or 2) */
+    int p = sArr[e] == '=' ? ((e > s && sArr[e - 1] == '=') ? 2 : 1) : 0;  /* Count '=' at end. */
+    int cCnt = e - s + 1;   /* Content count including possible separators */
+    int sep = sLen > 76 ? (sArr[76] == '\r' ? cCnt / 78 : 0) << 1 : 0;
+    
+    *sIx = s;
+    *eIx = e;
+    *pad = p;
+    *sepCnt = sep;
+    
+    int dLen = ((cCnt - sep) * 6 >> 3) - p; /* The number of decoded bytes */
+    return dLen > 0 ? dLen : 0;
+}
+
+/* Decodes the content laid out by MIG_fastLayout into 'dArr' */
+static void MIG_decodeFastTo(const char *sArr, int sIx, int eIx, int pad, int sepCnt, unsigned char *dArr, int dLen)
+{
+    /* Decode all but the last 0 - 2 bytes. */
+    int d = 0;
+    for (int cc = 0, eLen = (dLen / 3) * 3; d < eLen;)
+    {
+        /* Assemble three bytes into an int from four "valid" characters. */
+        int i = IA[sArr[sIx] & 0xff] << 18 | IA[sArr[sIx + 1] & 0xff] << 12 |
+                IA[sArr[sIx + 2] & 0xff] << 6 | IA[sArr[sIx + 3] & 0xff];
+        sIx += 4;
         
         /* Add the bytes */
         dArr[d++] = (unsigned char) (i >> 16);
@@ -354,11 +828,50 @@ MIG_Result MIG_decodeAsBase64Fast(const char *sArr,
         /* Decode last 1-3 bytes (incl '=') into 1-3 bytes */
         int i = 0;
         for (int j = 0; sIx <= eIx - pad; j++)
-            i |= IA[sArr[sIx++]] << (18 - j * 6);
+            i |= IA[sArr[sIx++] & 0xff] << (18 - j * 6);
         
         for (int r = 16; d < dLen; r -= 8)
             dArr[d++] = (unsigned char) (i >> r);
     }
+}
+
+/** Decodes a BASE64 encoded byte array that is known to be resonably well formatted. The method is about twice as
+ * fast as {@link #decode(byte[])}. The preconditions are:<br>
+ * + The array must have a line length of 76 chars OR no line separators at all (one line).<br>
+ * + Line separator must be "\r\n", as specified in RFC 2045
+ * + The array must not contain illegal characters within the encoded string<br>
+ * + The array CAN have illegal characters at the beginning and end, those will be dealt with appropriately.<br>
+ * @param sArr The source array. Length 0 will return an empty array. <code>null</code> will throw an exception.
+ * @return The decoded array of bytes. May be of length 0.
+ */
+MIG_Result MIG_decodeAsBase64Fast(const char *sArr,
+                                  unsigned int sLen,
+                                  unsigned char **result,
+                                  unsigned int *resultLen)
+{
+    /* Check special case */
+    if (sArr == NULL)
+    {
+        return MIG_InputDataEmpty;
+    }
+    else if (sLen == 0)
+    {
+        /* Empty string -- return empty string according to RFC */
+        *result = (unsigned char *)calloc(1, sizeof(unsigned char));
+        *resultLen = 0;
+        return MIG_OK;
+    }
+    
+    int sIx, eIx, pad, sepCnt;
+    int dLen = MIG_fastLayout(sArr, sLen, &sIx, &eIx, &pad, &sepCnt);
+    
+    unsigned char *dArr = (unsigned char *)calloc(dLen > 0 ? dLen : 1, sizeof(unsigned char));
+    if (dArr == NULL)
+    {
+        return MIG_NoMemory;
+    }
+    
+    MIG_decodeFastTo(sArr, sIx, eIx, pad, sepCnt, dArr, dLen);
     
     *result = dArr;
     *resultLen = dLen;
@@ -366,4 +879,631 @@ MIG_Result MIG_decodeAsBase64Fast(const char *sArr,
     return MIG_OK;
 }
 
+MIG_Result MIG_decodeAsBase64FastInto(const char *sArr,
+                                      unsigned int sLen,
+                                      unsigned char *dArr,
+                                      unsigned int dLen,
+                                      unsigned int *resultLen)
+{
+    if (sArr == NULL)
+    {
+        return MIG_InputDataEmpty;
+    }
+    
+    int sIx = 0, eIx = 0, pad = 0, sepCnt = 0;
+    int fLen = sLen > 0 ? MIG_fastLayout(sArr, sLen, &sIx, &eIx, &pad, &sepCnt) : 0;
+    if (dLen < (unsigned int)fLen)
+    {
+        return MIG_OutputTooSmall;
+    }
+    
+    MIG_decodeFastTo(sArr, sIx, eIx, pad, sepCnt, dArr, fLen);
+    *resultLen = fLen;
+    
+    return MIG_OK;
+}
+
+
+
+#pragma mark -
+#pragma mark Scatter-gather (iovec) conversion
+
+#if MIG_USE_IOVEC
+
+/* Total length of the segments */
+static size_t MIG_segmentsLength(const struct iovec *vec, unsigned int cnt)
+{
+    size_t len = 0;
+    for (unsigned int i = 0; i < cnt; i++)
+        len += vec[i].iov_len;
+    return len;
+}
+
+/* Moves 'pos' past full (or empty) segments */
+static inline void MIG_segmentNormalize(const struct iovec *vec, unsigned int cnt, MIG_SegmentPosition *pos)
+{
+    while (pos->segment < cnt && pos->offset >= vec[pos->segment].iov_len)
+    {
+        pos->segment++;
+        pos->offset = 0;
+    }
+}
+
+/* Scans 'sArr' for its first 'k' legal characters (including '='), returning how many it found.  '*end' is
+   set just past the last of them, or to 'sLen' if there are fewer.  Only the characters up to there are read. */
+static size_t MIG_legalSpan(const char *sArr, size_t sLen, size_t k, size_t *end)
+{
+    size_t e = 0, cnt = 0;
+    
+    /* A block at a time while it can't hold more than are wanted */
+    while (sLen - e >= 256 && k - cnt >= 256)
+    {
+        cnt += 256 - MIG_countIllegal(sArr + e, 256);
+        e += 256;
+    }
+    for (; e < sLen && cnt < k; e++)
+    {
+        if (IA[sArr[e] & 0xff] >= 0)
+            cnt++;
+    }
+    
+    *end = e;
+    return cnt;
+}
+
+/* Writes 'n' bytes at 'pos', spilling over segment edges as required.  Space must have been checked. */
+static void MIG_segmentWrite(const struct iovec *vec, unsigned int cnt, MIG_SegmentPosition *pos, const void *src, size_t n)
+{
+    const char *p = (const char *)src;
+    while (n > 0)
+    {
+        MIG_segmentNormalize(vec, cnt, pos);
+        size_t room = vec[pos->segment].iov_len - pos->offset;
+        size_t m = n < room ? n : room;
+        memcpy((char *)vec[pos->segment].iov_base + pos->offset, p, m);
+        pos->offset += m;
+        pos->total += m;
+        p += m;
+        n -= m;
+    }
+    MIG_segmentNormalize(vec, cnt, pos);
+}
+
+/* Encodes one quantum into 'dArr' (4 chars, plus the optional line separator), returning the count written */
+static inline unsigned int MIG_encodeQuantum(int useOptionalLineEndings, const unsigned char *sArr, char *dArr,
+                                             int *cc, size_t *d, size_t dLen)
+{
+    int i = (sArr[0] & 0xff) << 16 | (sArr[1] & 0xff) << 8 | (sArr[2] & 0xff);
+    dArr[0] = CA[(i >> 18) & 0x3f];
+    dArr[1] = CA[(i >> 12) & 0x3f];
+    dArr[2] = CA[(i >> 6) & 0x3f];
+    dArr[3] = CA[i & 0x3f];
+    *d += 4;
+    
+    /* Add optional line separator */
+    if ((useOptionalLineEndings==1) && ++(*cc) == 19 && *d < dLen - 2)
+    {
+        dArr[4] = '\r';
+        dArr[5] = '\n';
+        *d += 2;
+        *cc = 0;
+        return 6;
+    }
+    return 4;
+}
+
+MIG_Result MIG_encodeAsBase64Segments(int useOptionalLineEndings,
+                                      const struct iovec *sVec,
+                                      unsigned int sCnt,
+                                      const struct iovec *dVec,
+                                      unsigned int dCnt,
+                                      MIG_SegmentPosition *consumed,
+                                      MIG_SegmentPosition *filled)
+{
+    MIG_SegmentPosition out = { 0, 0, 0 };
+    
+    if (sVec == NULL)
+    {
+        return MIG_InputDataEmpty;
+    }
+    
+    size_t sLen = MIG_segmentsLength(sVec, sCnt);
+    size_t cCnt = sLen > 0 ? ((sLen - 1) / 3 + 1) << 2 : 0;                                /* Returned character count */
+    size_t dLen = cCnt + ((useOptionalLineEndings==1 && cCnt > 0) ? (cCnt - 1) / 76 << 1 : 0); /* Length of returned data */
+    
+    /* Short of room, encode as many whole quanta as fit (whole lines, separator included, when formatted)
+       so that a later call can carry on from where this one stopped */
+    size_t take = sLen;
+    if (MIG_segmentsLength(dVec, dCnt) < dLen)
+    {
+        size_t room = MIG_segmentsLength(dVec, dCnt);
+        take = useOptionalLineEndings==1 ? room / 78 * 57 : room / 4 * 3;
+    }
+    
+    unsigned char carry[3];     /* Quantum split across an input segment edge */
+    unsigned int carryLen = 0;
+    char quad[6];
+    size_t d = 0, left = take;
+    int cc = 0;
+    MIG_SegmentPosition in = { 0, 0, take };
+    
+    for (unsigned int seg = 0; seg < sCnt && left > 0; seg++)
+    {
+        const unsigned char *p = (const unsigned char *)sVec[seg].iov_base;
+        size_t n = sVec[seg].iov_len < left ? sVec[seg].iov_len : left;
+        left -= n;
+        in.segment = seg;
+        in.offset = n;
+        
+        /* Complete a quantum carried over from the previous segment */
+        while (carryLen > 0 && carryLen < 3 && n > 0)
+        {
+            carry[carryLen++] = *p++;
+            n--;
+        }
+        if (carryLen == 3)
+        {
+            unsigned int q = MIG_encodeQuantum(useOptionalLineEndings, carry, quad, &cc, &d, dLen);
+            MIG_segmentWrite(dVec, dCnt, &out, quad, q);
+            carryLen = 0;
+        }
+        
+        while (n >= 3)
+        {
+            /* Encode straight into the current output segment for as many quanta as are guaranteed to fit */
+            MIG_segmentNormalize(dVec, dCnt, &out);
+            char *o = (char *)dVec[out.segment].iov_base + out.offset;
+            size_t run = (dVec[out.segment].iov_len - out.offset) / (useOptionalLineEndings==1 ? 6 : 4);
+            if (run > n / 3)
+                run = n / 3;
+            
+            if (run == 0)
+            {
+                /* Quantum split across an output segment edge */
+                unsigned int q = MIG_encodeQuantum(useOptionalLineEndings, p, quad, &cc, &d, dLen);
+                MIG_segmentWrite(dVec, dCnt, &out, quad, q);
+                p += 3;
+                n -= 3;
+                continue;
+            }
+            
+            size_t written = 0;
+            for (size_t r = 0; r < run; r++, p += 3)
+                written += MIG_encodeQuantum(useOptionalLineEndings, p, o + written, &cc, &d, dLen);
+            
+            n -= run * 3;
+            out.offset += written;
+            out.total += written;
+        }
+        
+        while (n > 0)
+        {
+            carry[carryLen++] = *p++;
+            n--;
+        }
+    }
+    
+    /* Pad and encode last bits if source isn't even 24 bits. */
+    if (carryLen > 0)
+    {
+        int i = ((carry[0] & 0xff) << 10) | (carryLen == 2 ? ((carry[1] & 0xff) << 2) : 0);
+        quad[0] = CA[i >> 12];
+        quad[1] = CA[(i >> 6) & 0x3f];
+        quad[2] = carryLen == 2 ? CA[i & 0x3f] : '=';
+        quad[3] = '=';
+        MIG_segmentWrite(dVec, dCnt, &out, quad, 4);
+    }
+    
+    MIG_segmentNormalize(sVec, sCnt, &in);
+    MIG_segmentNormalize(dVec, dCnt, &out);
+    if (consumed)
+    {
+        *consumed = in;
+    }
+    if (filled)
+    {
+        *filled = out;
+    }
+    
+    return take < sLen ? MIG_OutputTooSmall : MIG_OK;
+}
+
+MIG_Result MIG_decodeAsBase64Segments(const struct iovec *sVec,
+                                      unsigned int sCnt,
+                                      const struct iovec *dVec,
+                                      unsigned int dCnt,
+                                      MIG_SegmentPosition *consumed,
+                                      MIG_SegmentPosition *filled)
+{
+    MIG_SegmentDecodeState state = { 0, 0 };
+    return MIG_decodeAsBase64SegmentsResumable(sVec, sCnt, dVec, dCnt, &state, consumed, filled);
+}
 
+MIG_Result MIG_decodeAsBase64SegmentsResumable(const struct iovec *sVec,
+                                               unsigned int sCnt,
+                                               const struct iovec *dVec,
+                                               unsigned int dCnt,
+                                               MIG_SegmentDecodeState *state,
+                                               MIG_SegmentPosition *consumed,
+                                               MIG_SegmentPosition *filled)
+{
+    MIG_SegmentPosition out = { 0, 0, 0 };
+    
+    if (sVec == NULL)
+    {
+        return MIG_Base64StringEmpty;
+    }
+    
+    /* The character counts below are 32 bit, as elsewhere in the converter */
+    size_t sLen = 0;
+    for (unsigned int seg = 0; seg < sCnt; seg++)
+    {
+        if (sVec[seg].iov_len > UINT_MAX)
+        {
+            return MIG_InputTooLarge;
+        }
+        sLen += sVec[seg].iov_len;
+    }
+    
+    if (!state->validated)
+    {
+        /* Count illegal characters across all segments to know the size of the result */
+        size_t sepCnt = 0;
+        for (unsigned int seg = 0; seg < sCnt; seg++)
+        {
+            sepCnt += MIG_countIllegal((const char *)sVec[seg].iov_base, (unsigned int)sVec[seg].iov_len);
+        }
+        
+        /* Check so that legal chars (including '=') are evenly divideable by 4 as specified in RFC 2045. */
+        if ((sLen - sepCnt) % 4 != 0)
+        {
+            return MIG_Base64EncodingInvalid;
+        }
+        
+        /* Count the padding, walking backwards over the segments */
+        size_t pad = 0, g = sLen;   /* 'g' is one past the overall index of the character being examined */
+        int done = 0;
+        for (unsigned int seg = sCnt; seg > 0 && !done; seg--)
+        {
+            const char *p = (const char *)sVec[seg - 1].iov_base;
+            for (size_t k = sVec[seg - 1].iov_len; k > 0; k--, g--)
+            {
+                if (g <= 1 || IA[p[k - 1] & 0xff] > 0)
+                {
+                    done = 1;
+                    break;
+                }
+                if (p[k - 1] == '=')
+                    pad++;
+            }
+        }
+        
+        /* At most two '=', and never more than the data they pad */
+        size_t legalLen = (sLen - sepCnt) * 6 >> 3;
+        if (pad > 2 || pad > legalLen)
+        {
+            return MIG_Base64EncodingInvalid;
+        }
+        
+        state->validated = 1;
+        state->remaining = legalLen - pad;
+    }
+    
+    size_t dLen = state->remaining;
+    
+    /* Short of room, decode as many whole quanta as fit so that a later call can carry on from where
+       this one stopped.  The padded last quantum is never among them, as it would have fitted. */
+    int partial = MIG_segmentsLength(dVec, dCnt) < dLen;
+    if (partial)
+    {
+        dLen = MIG_segmentsLength(dVec, dCnt) / 3 * 3;
+    }
+    
+    size_t d = 0, base = 0;     /* 'base' is the overall index of the start of the current segment */
+    int i = 0, j = 0;   /* Quantum being assembled, and its count of valid characters */
+    MIG_SegmentPosition in = { partial ? 0 : sCnt, 0, partial ? 0 : sLen };
+    
+    for (unsigned int seg = 0; seg < sCnt && d < dLen; base += sVec[seg].iov_len, seg++)
+    {
+        const char *start = (const char *)sVec[seg].iov_base;
+        const char *p = start;
+        size_t n = sVec[seg].iov_len;
+        int quanta = 1;     /* The segment may still hold a whole quantum */
+        
+        while (n > 0 && d < dLen)
+        {
+            /* On a quantum boundary, hand as many whole quanta as the current output segment holds to
+               the block decoder.  Only the characters they need are scanned, so draining a long segment
+               through a small output buffer stays linear */
+            if (j == 0 && quanta)
+            {
+                MIG_segmentNormalize(dVec, dCnt, &out);
+                size_t limit = dLen - d;
+                size_t space = out.segment < dCnt ? dVec[out.segment].iov_len - out.offset : 0;
+                if (space < limit)
+                    limit = space / 3 * 3;
+                
+                if (limit > 0)
+                {
+                    size_t e, legal = MIG_legalSpan(p, n, (limit + 2) / 3 * 4, &e);
+                    size_t bytes = legal / 4 * 3;
+                    if (bytes < limit)
+                    {
+                        /* The segment ends first, so leave its partial quantum to the loop below */
+                        for (size_t extra = legal & 3; extra > 0;)
+                        {
+                            if (IA[p[--e] & 0xff] >= 0)
+                                extra--;
+                        }
+                        quanta = 0;
+                    }
+                    else
+                    {
+                        bytes = limit;
+                    }
+                    
+                    if (bytes > 0)
+                    {
+                        MIG_decodeLegal(p, (unsigned int)e, (unsigned char *)dVec[out.segment].iov_base + out.offset, (unsigned int)bytes);
+                        out.offset += bytes;
+                        out.total += bytes;
+                        d += bytes;
+                        p += e;
+                        n -= e;
+                        continue;
+                    }
+                }
+            }
+            
+            /* A character at a time, for quanta split across input or output segment edges */
+            int c = IA[*p & 0xff];
+            p++;
+            n--;
+            if (c < 0)
+                continue;
+            
+            i |= c << (18 - j * 6);
+            if (++j == 4)
+            {
+                /* Add the bytes */
+                unsigned char tri[3] = { (unsigned char)(i >> 16), (unsigned char)(i >> 8), (unsigned char)i };
+                size_t m = dLen - d < 3 ? dLen - d : 3;
+                MIG_segmentWrite(dVec, dCnt, &out, tri, m);
+                d += m;
+                i = 0;
+                j = 0;
+            }
+        }
+        
+        if (partial)
+        {
+            in.segment = seg;
+            in.offset = p - start;
+            in.total = base + in.offset;
+        }
+    }
+    
+    state->remaining -= d;
+    
+    MIG_segmentNormalize(sVec, sCnt, &in);
+    MIG_segmentNormalize(dVec, dCnt, &out);
+    if (consumed)
+    {
+        *consumed = in;
+    }
+    if (filled)
+    {
+        *filled = out;
+    }
+    
+    return partial ? MIG_OutputTooSmall : MIG_OK;
+}
+
+#endif
+
+
+#pragma mark -
+#pragma mark Small payloads
+
+/* Digests, UUIDs and tokens are encoded and decoded straight into a caller (usually stack) owned struct.
+   There's no allocation, no line separator handling, and the common sizes are handled by constant trip
+   count loops that the compiler unrolls completely. */
+
+/* Inlining and unrolling hints, for the compilers that take them.  Elsewhere they are plain 'static inline' */
+#if defined(__GNUC__) || defined(__clang__)
+#define MIG_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define MIG_ALWAYS_INLINE inline
+#endif
+
+#define MIG_PRAGMA(x) _Pragma(#x)
+#if defined(__clang__)
+#define MIG_UNROLL(n) MIG_PRAGMA(unroll n)
+#elif defined(__GNUC__) && __GNUC__ >= 8
+#define MIG_UNROLL(n) MIG_PRAGMA(GCC unroll n)
+#else
+#define MIG_UNROLL(n)
+#endif
+
+/* Encodes 'groups' whole 3 byte groups */
+static MIG_ALWAYS_INLINE void MIG_encodeGroups(const unsigned char *sArr, char *dArr, unsigned int groups)
+{
+    MIG_UNROLL(24)
+    for (unsigned int g = 0; g < groups; g++, sArr += 3, dArr += 4)
+    {
+        unsigned int i = sArr[0] << 16 | sArr[1] << 8 | sArr[2];
+        dArr[0] = CA[i >> 18];
+        dArr[1] = CA[(i >> 12) & 0x3f];
+        dArr[2] = CA[(i >> 6) & 0x3f];
+        dArr[3] = CA[i & 0x3f];
+    }
+}
+
+/* Encodes the last 1 or 2 bytes as a padded quantum */
+static inline void MIG_encodeTail(const unsigned char *sArr, char *dArr, unsigned int left)
+{
+    unsigned int i = sArr[0] << 10 | (left == 2 ? sArr[1] << 2 : 0);
+    dArr[0] = CA[i >> 12];
+    dArr[1] = CA[(i >> 6) & 0x3f];
+    dArr[2] = left == 2 ? CA[i & 0x3f] : '=';
+    dArr[3] = '=';
+}
+
+/* The 6-bit value of 'c', negative if 'c' is illegal or '=' */
+static inline int MIG_smallValue(char c)
+{
+    return IA[c & 0xff] | -(c == '=');
+}
+
+/* Decodes 'quanta' whole, unpadded quanta.  Returns a negative value if any char was illegal, without
+   branching on it */
+static MIG_ALWAYS_INLINE int MIG_decodeQuanta(const char *sArr, unsigned char *dArr, unsigned int quanta)
+{
+    int bad = 0;
+    unsigned int q = 0;
+    
+#if MIG_USE_SSSE3
+    /* Four quanta at a time, storing exactly 12 bytes so the end of the result isn't overrun */
+    unsigned int illegal = 0;
+    for (; q + 4 <= quanta; q += 4, sArr += 16, dArr += 12)
+    {
+        unsigned int mask;
+        __m128i v = _mm_loadu_si128((const __m128i *)sArr);
+        __m128i packed = MIG_pack16(MIG_translate16(v, &mask));
+        illegal |= mask | _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+        
+        unsigned int top = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+        _mm_storel_epi64((__m128i *)dArr, packed);
+        memcpy(dArr + 8, &top, 4);
+    }
+    bad = -(illegal != 0);
+#endif
+    
+    for (; q < quanta; q++, sArr += 4, dArr += 3)
+    {
+        int a = MIG_smallValue(sArr[0]), b = MIG_smallValue(sArr[1]);
+        int c = MIG_smallValue(sArr[2]), d = MIG_smallValue(sArr[3]);
+        bad |= a | b | c | d;
+        
+        unsigned int i = (unsigned int)a << 18 | (unsigned int)b << 12 | (unsigned int)c << 6 | (unsigned int)d;
+        dArr[0] = (unsigned char)(i >> 16);
+        dArr[1] = (unsigned char)(i >> 8);
+        dArr[2] = (unsigned char)i;
+    }
+    return bad;
+}
+
+MIG_Result MIG_encodeSmall(const unsigned char *sArr,
+                           unsigned int sLen,
+                           MIG_SmallEncoded *result)
+{
+    if (sArr == NULL)
+    {
+        return MIG_InputDataEmpty;
+    }
+    else if (sLen > MIG_SMALL_MAX_BYTES)
+    {
+        return MIG_OutputTooSmall;
+    }
+    
+    char *dArr = result->chars;
+    switch (sLen)
+    {
+        case 16:    /* UUIDs, MD5 */
+            MIG_encodeGroups(sArr, dArr, 5);
+            MIG_encodeTail(sArr + 15, dArr + 20, 1);
+            break;
+        case 20:    /* SHA-1 */
+            MIG_encodeGroups(sArr, dArr, 6);
+            MIG_encodeTail(sArr + 18, dArr + 24, 2);
+            break;
+        case 32:    /* SHA-256, 256 bit keys and tokens */
+            MIG_encodeGroups(sArr, dArr, 10);
+            MIG_encodeTail(sArr + 30, dArr + 40, 2);
+            break;
+        case 64:    /* SHA-512, 512 bit tokens */
+            MIG_encodeGroups(sArr, dArr, 21);
+            MIG_encodeTail(sArr + 63, dArr + 84, 1);
+            break;
+        default:
+        {
+            unsigned int groups = sLen / 3, left = sLen - groups * 3;
+            MIG_encodeGroups(sArr, dArr, groups);
+            if (left > 0)
+            {
+                MIG_encodeTail(sArr + groups * 3, dArr + groups * 4, left);
+            }
+            break;
+        }
+    }
+    
+    result->length = (sLen + 2) / 3 * 4;
+    result->chars[result->length] = '\0';
+    return MIG_OK;
+}
+
+MIG_Result MIG_decodeSmall(const char *sArr,
+                           unsigned int sLen,
+                           MIG_SmallDecoded *result)
+{
+    result->length = 0;
+    if (sArr == NULL)
+    {
+        return MIG_Base64StringEmpty;
+    }
+    else if (sLen > MIG_SMALL_MAX_CHARS)
+    {
+        return MIG_OutputTooSmall;
+    }
+    else if (sLen % 4 != 0)
+    {
+        return MIG_Base64Truncated;
+    }
+    else if (sLen == 0)
+    {
+        return MIG_OK;
+    }
+    
+    /* All but the last quantum */
+    unsigned char *dArr = result->bytes;
+    int bad;
+    switch (sLen)
+    {
+        case 24:    /* 16 bytes */
+            bad = MIG_decodeQuanta(sArr, dArr, 5);
+            break;
+        case 28:    /* 20 bytes */
+            bad = MIG_decodeQuanta(sArr, dArr, 6);
+            break;
+        case 44:    /* 32 bytes */
+            bad = MIG_decodeQuanta(sArr, dArr, 10);
+            break;
+        case 88:    /* 64 bytes */
+            bad = MIG_decodeQuanta(sArr, dArr, 21);
+            break;
+        default:
+            bad = MIG_decodeQuanta(sArr, dArr, sLen / 4 - 1);
+            break;
+    }
+    
+    /* The last quantum, where the values of up to two trailing '=' are masked to 0 */
+    const char *s = sArr + sLen - 4;
+    int pad3 = s[3] == '=', pad2 = pad3 & (s[2] == '=');
+    int a = MIG_smallValue(s[0]), b = MIG_smallValue(s[1]);
+    int c = MIG_smallValue(s[2]) & (pad2 - 1), d = MIG_smallValue(s[3]) & (pad3 - 1);
+    bad |= a | b | c | d;
+    
+    if (bad < 0)
+    {
+        return MIG_Base64IllegalCharacter;
+    }
+    
+    unsigned int i = a << 18 | b << 12 | c << 6 | d;
+    unsigned char *t = dArr + (sLen / 4 - 1) * 3;
+    t[0] = (unsigned char)(i >> 16);
+    t[1] = (unsigned char)(i >> 8);
+    t[2] = (unsigned char)i;
+    
+    result->length = sLen / 4 * 3 - pad3 - pad2;
+    return MIG_OK;
+}
@@ -85,6 +85,26 @@
 #ifndef MIGConverter_h
 #define MIGConverter_h
 
+#include <stddef.h>
+
+/* The scatter-gather calls use struct iovec from POSIX <sys/uio.h>.  Define MIG_USE_IOVEC as 0 to build
+   without them, or as 1 on other platforms that provide the header. */
+#if !defined(MIG_USE_IOVEC)
+#if defined(__unix__) || defined(__APPLE__)
+#define MIG_USE_IOVEC 1
+#else
+#define MIG_USE_IOVEC 0
+#endif
+#endif
+
+#if MIG_USE_IOVEC
+#include <sys/uio.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum eMIG_Result
 {
     MIG_OK = 0,                         /* Conversion successful */
@@ -93,8 +113,38 @@ typedef enum eMIG_Result
     MIG_Base64StringEmpty = -3,         /* Supplied Base64 string for decoding was NULL */
     MIG_Base64EncodingInvalid = -4,     /* Base64 string for decoding wasn't valid Base64 */
     MIG_Base64UnknownError = -5,        /* An unknown error occurred */
+    MIG_Base64IllegalCharacter = -6,    /* Strict decoding found a character outside the alphabet and line separators */
+    MIG_Base64PaddingInvalid = -7,      /* Strict decoding found a misplaced '=', or data following the padding */
+    MIG_Base64Truncated = -8,           /* Strict decoding ran out of characters part way through a quantum */
+    MIG_OutputTooSmall = -9,            /* The supplied output buffers can't hold the result */
+    MIG_IOError = -10,                  /* A read from or write to a file descriptor failed (see errno) */
+    MIG_InputTooLarge = -11,            /* An input segment of 4GB or more (lengths are 32 bit) */
 } MIG_Result;
 
+/** Extended result for calls that can identify where in the input a failure occurred */
+typedef struct sMIG_ErrorDetail
+{
+    MIG_Result result;                  /* The status of the call */
+    unsigned int offset;                /* Byte offset of the offending character (the input length if truncated) */
+} MIG_ErrorDetail;
+
+#if MIG_USE_IOVEC
+/** A position within an array of segments (struct iovec) */
+typedef struct sMIG_SegmentPosition
+{
+    unsigned int segment;               /* Index of the segment containing the position (the segment count at the very end) */
+    size_t offset;                      /* Byte offset of the position within that segment */
+    size_t total;                       /* Total number of bytes before the position across all segments */
+} MIG_SegmentPosition;
+
+/** What MIG_decodeAsBase64SegmentsResumable knows about the whole input, kept from one call to the next */
+typedef struct sMIG_SegmentDecodeState
+{
+    int validated;                      /* Non-zero once the whole input has been validated */
+    size_t remaining;                   /* Decoded bytes still to be written, less the padding */
+} MIG_SegmentDecodeState;
+#endif
+
 /** 
     Encodes the supplied byte array 'sArr' into the result array 'result'.
     Parameters :-
@@ -114,6 +164,9 @@ MIG_Result MIG_encodeAsBase64(int useOptionalLineEndings,
 
 /** 
     Decodes the supplied Base64 encoded array 'sArr' into the result array 'result'.
+    All illegal characters (line separators of any kind, whitespace, escapes etc.) are ignored.
+    When built with SSSE3 the illegal characters are compacted out 16 characters at a time,
+    so wrapped input decodes at close to the speed of unwrapped input.
     Parameters :-
       sArr: the byte array to be decoded
       sLen: the length of the supplied array 'sArr'
@@ -127,6 +180,193 @@ MIG_Result MIG_decodeAsBase64(const char *sArr,
                               unsigned char **result,
                               unsigned int *resultLen);
 
+/** 
+    Returns the length (in chars) of the Base64 encoding of 'sLen' bytes, as produced by
+    MIG_encodeAsBase64 and MIG_encodeAsBase64Into.
+*/
+unsigned int MIG_encodedLength(int useOptionalLineEndings,
+                               unsigned int sLen);
+
+/** 
+    Encodes the supplied byte array 'sArr' into the caller supplied array 'dArr'.
+    No memory is allocated, so the result can be written straight into an existing buffer.
+    Parameters :-
+      useOptionalLineEndings:  0 == unformated, all else == formatted
+      sArr: the byte array to be converted
+      sLen: the length of the supplied array 'sArr'
+      dArr: the array to receive the encoding
+      dLen: the length of 'dArr'.  Must be at least MIG_encodedLength(useOptionalLineEndings, sLen)
+      resultLen: the number of chars written to 'dArr'
+    Returns :-
+      The status of the call (see eMIG_Result enum)
+*/
+MIG_Result MIG_encodeAsBase64Into(int useOptionalLineEndings,
+                                  const unsigned char *sArr,
+                                  unsigned int sLen,
+                                  char *dArr,
+                                  unsigned int dLen,
+                                  unsigned int *resultLen);
+
+/** 
+    Validates the supplied Base64 encoded array 'sArr' with the same rules as MIG_decodeAsBase64,
+    and returns the length of the decoded result in 'resultLen'.
+    Returns :-
+      The status of the call (see eMIG_Result enum)
+*/
+MIG_Result MIG_decodedLength(const char *sArr,
+                             unsigned int sLen,
+                             unsigned int *resultLen);
+
+/** 
+    Decodes the supplied Base64 encoded array 'sArr' into the caller supplied array 'dArr'.
+    No memory is allocated, so the result can be written straight into an existing buffer.
+    Parameters :-
+      sArr: the byte array to be decoded
+      sLen: the length of the supplied array 'sArr'
+      dArr: the array to receive the decoded bytes
+      dLen: the decoded length, as returned by MIG_decodedLength for 'sArr'.
+    Returns :-
+      The status of the call (see eMIG_Result enum)
+*/
+MIG_Result MIG_decodeAsBase64Into(const char *sArr,
+                                  unsigned int sLen,
+                                  unsigned char *dArr,
+                                  unsigned int dLen);
+
+/** 
+    For decoding in blocks.  Returns the number of legal characters (the alphabet and '=') in 'sArr',
+    ie. the characters that MIG_decodeAsBase64Into would decode rather than skip.
+*/
+unsigned int MIG_legalLength(const char *sArr,
+                             unsigned int sLen);
+
+/** 
+    For decoding a stream in blocks.  Returns the length of the longest prefix of 'sArr' holding a
+    whole number of quanta (a multiple of 4 legal characters), so it can be passed to MIG_decodeAsBase64Into
+    with a decoded length of MIG_legalLength() / 4 * 3.  The legal characters of the trailing partial
+    quantum (at most 3) are copied to 'carry', to be placed in front of the next block.
+    Padding is a property of the end of the whole stream, not of each block (see MIG_trackPadding).
+    Parameters :-
+      sArr: the Base64 characters of the current block
+      sLen: the length of the supplied array 'sArr'
+      carry: receives the characters of the partial quantum.  Must hold at least 3 chars.
+      carryLen: receives the number of chars copied to 'carry'
+    Returns :-
+      The length of the decodable prefix.  0 if the block holds no whole quantum.
+*/
+unsigned int MIG_decodableLength(const char *sArr,
+                                 unsigned int sLen,
+                                 char *carry,
+                                 unsigned int *carryLen);
+
+/**
+    For decoding a stream in blocks.  Counts the '=' padding at the end of the stream read so far,
+    exactly as MIG_decodedLength counts it over a whole input, so that a '=' in the middle of the
+    stream decodes as it would in a single call.  Call it on each block of raw input in stream order;
+    once the stream has ended, more than 2 is invalid, otherwise that many bytes are trimmed from
+    the end of the decoded stream.
+    Parameters :-
+      sArr: the next block of the stream, as read
+      sLen: the length of the supplied array 'sArr'
+      streamStart: non-zero if 'sArr' is the first block of the stream
+      pad: the padding count, 0 before the first block.  Updated in place (saturating at 3)
+*/
+void MIG_trackPadding(const char *sArr,
+                      unsigned int sLen,
+                      int streamStart,
+                      unsigned int *pad);
+
+/** 
+    Strictly decodes the supplied Base64 encoded array 'sArr' into the result array 'result'.
+    Only the Base64 alphabet, '=' padding and line separators ('\r', '\n') are accepted.  The input
+    is rejected at the first illegal character or misplaced '=' without allocating the result.
+    Parameters :-
+      sArr: the byte array to be decoded
+      sLen: the length of the supplied array 'sArr'
+      result: the resulting decoded array.  Caller must free() the returned memory.
+      resultLen: the length (in bytes) of the result array 'result'.
+      detail: if not NULL, receives the status and the byte offset into 'sArr' of the failure.
+    Returns :-
+      The status of the call (see eMIG_Result enum)
+*/
+MIG_Result MIG_decodeAsBase64Strict(const char *sArr,
+                                    unsigned int sLen,
+                                    unsigned char **result,
+                                    unsigned int *resultLen,
+                                    MIG_ErrorDetail *detail);
+
+#if MIG_USE_IOVEC
+
+/** 
+    Encodes the bytes held in the segments 'sVec' into the output segments 'dVec', for use with
+    readv()/writev() style scatter-gather I/O.  Quanta split across segment edges are carried over,
+    so segments may be of any length.  No memory is allocated.  The output is identical to that of
+    MIG_encodeAsBase64 for the concatenated input.
+    Parameters :-
+      useOptionalLineEndings:  0 == unformated, all else == formatted
+      sVec, sCnt: the input segments
+      dVec, dCnt: the output segments
+      consumed: if not NULL, receives the position in 'sVec' after the last byte consumed.
+      filled: if not NULL, receives the position in 'dVec' after the last byte written, so
+              'filled->segment' full segments plus 'filled->offset' bytes of the next hold the result.
+    Returns :-
+      The status of the call (see eMIG_Result enum).  When 'dVec' can't hold the whole result, as many
+      whole quanta as fit are written (whole lines, each with its separator, when formatted) and
+      MIG_OutputTooSmall is returned.  'consumed' and 'filled' then say how far the call got; calling
+      again with the input from 'consumed' onwards continues the encoding exactly where it stopped.
+      Less than 4 bytes of output (78 when formatted) writes nothing.
+*/
+MIG_Result MIG_encodeAsBase64Segments(int useOptionalLineEndings,
+                                      const struct iovec *sVec,
+                                      unsigned int sCnt,
+                                      const struct iovec *dVec,
+                                      unsigned int dCnt,
+                                      MIG_SegmentPosition *consumed,
+                                      MIG_SegmentPosition *filled);
+
+/** 
+    Decodes the Base64 characters held in the segments 'sVec' into the output segments 'dVec', with
+    the same (lenient) rules as MIG_decodeAsBase64.  Quanta split across segment edges are carried over.
+    No memory is allocated.
+    Parameters :-
+      sVec, sCnt: the input segments
+      dVec, dCnt: the output segments
+      consumed: if not NULL, receives the position in 'sVec' after the last character consumed.
+      filled: if not NULL, receives the position in 'dVec' after the last byte written.
+    Returns :-
+      The status of the call (see eMIG_Result enum).  The whole input is validated first, so invalid
+      Base64 writes nothing.  When 'dVec' can't hold the whole result, as many whole quanta as fit are
+      written and MIG_OutputTooSmall is returned.  'consumed' and 'filled' then say how far the call
+      got; calling again with the input from 'consumed' onwards continues the decoding.  As each call
+      validates all of the input it is given, use MIG_decodeAsBase64SegmentsResumable to drain a
+      large input through a small output buffer.  Segments of 4GB or more return MIG_InputTooLarge.
+*/
+MIG_Result MIG_decodeAsBase64Segments(const struct iovec *sVec,
+                                      unsigned int sCnt,
+                                      const struct iovec *dVec,
+                                      unsigned int dCnt,
+                                      MIG_SegmentPosition *consumed,
+                                      MIG_SegmentPosition *filled);
+
+/** 
+    As MIG_decodeAsBase64Segments, but the input is only validated by the first call.  'state' records
+    the result, so the calls that resume from 'consumed' skip straight to decoding, and draining an
+    input of any size through a fixed output buffer takes time in proportion to the input.
+    Parameters :-
+      state: zeroed before the first call, then passed back unchanged with the input from 'consumed'
+             onwards.  Zero it again for a new input.
+    Returns :-
+      As MIG_decodeAsBase64Segments
+*/
+MIG_Result MIG_decodeAsBase64SegmentsResumable(const struct iovec *sVec,
+                                               unsigned int sCnt,
+                                               const struct iovec *dVec,
+                                               unsigned int dCnt,
+                                               MIG_SegmentDecodeState *state,
+                                               MIG_SegmentPosition *consumed,
+                                               MIG_SegmentPosition *filled);
+
+#endif
 
 /** Decodes a BASE64 encoded byte array that is known to be resonably well formatted. The method is about twice as
  * fast as {@link #decode(byte[])}. The preconditions are:<br>
@@ -142,6 +382,73 @@ MIG_Result MIG_decodeAsBase64Fast(const char *sArr,
                                   unsigned char **result,
                                   unsigned int *resultLen);
 
-#endif
+/** 
+    As MIG_decodeAsBase64Fast (with the same preconditions on 'sArr'), but decodes into the caller
+    supplied array 'dArr'.  No memory is allocated.
+    Parameters :-
+      dArr: the array to receive the decoded bytes
+      dLen: the length of 'dArr'.  sLen * 3 / 4 bytes is always enough.
+      resultLen: the number of bytes written to 'dArr'
+    Returns :-
+      The status of the call (see eMIG_Result enum)
+*/
+MIG_Result MIG_decodeAsBase64FastInto(const char *sArr,
+                                      unsigned int sLen,
+                                      unsigned char *dArr,
+                                      unsigned int dLen,
+                                      unsigned int *resultLen);
+
+#pragma mark -
+#pragma mark Small payloads
+
+#define MIG_SMALL_MAX_BYTES     72      /* Largest input of MIG_encodeSmall */
+#define MIG_SMALL_MAX_CHARS     96      /* Its (unformatted) encoding, MIG_encodedLength(0, 72) */
+
+typedef struct sMIG_SmallEncoded
+{
+    unsigned int length;                    /* Chars in 'chars' */
+    char chars[MIG_SMALL_MAX_CHARS + 1];    /* NUL terminated */
+} MIG_SmallEncoded;
+
+typedef struct sMIG_SmallDecoded
+{
+    unsigned int length;                    /* Bytes in 'bytes' */
+    unsigned char bytes[MIG_SMALL_MAX_BYTES];
+} MIG_SmallDecoded;
+
+/** 
+    Encodes up to MIG_SMALL_MAX_BYTES bytes (digests, UUIDs, tokens) into the caller supplied 'result',
+    which would usually live on the stack.  Nothing is allocated, and the common sizes (16, 20, 32 and
+    64 bytes) have fully unrolled paths.  The encoding is unformatted, and identical to that of
+    MIG_encodeAsBase64(0, ...).
+    Parameters :-
+      sArr: the byte array to be converted
+      sLen: the length of the supplied array 'sArr'.  At most MIG_SMALL_MAX_BYTES
+      result: receives the encoding and its length
+    Returns :-
+      The status of the call (see eMIG_Result enum)
+*/
+MIG_Result MIG_encodeSmall(const unsigned char *sArr,
+                           unsigned int sLen,
+                           MIG_SmallEncoded *result);
+
+/** 
+    Decodes up to MIG_SMALL_MAX_CHARS Base64 chars into the caller supplied 'result', without allocating.
+    The input must be unformatted: line separators and other illegal characters are rejected (with
+    MIG_Base64IllegalCharacter) rather than skipped, as is '=' anywhere but the last two positions.
+    Parameters :-
+      sArr: the Base64 chars to be decoded
+      sLen: the length of the supplied array 'sArr'.  A multiple of 4, at most MIG_SMALL_MAX_CHARS
+      result: receives the decoded bytes and their length (0 on failure)
+    Returns :-
+      The status of the call (see eMIG_Result enum)
+*/
+MIG_Result MIG_decodeSmall(const char *sArr,
+                           unsigned int sLen,
+                           MIG_SmallDecoded *result);
 
+#ifdef __cplusplus
+}
+#endif
 
+#endif
@@ -0,0 +1,522 @@
+//
+//  MIGPipeline.c
+//  Base64_Tests
+//
+//  Streams a file descriptor through the MIGConverter routines into another file descriptor.
+//
+//  The reader thread fills the slots of a ring in sequence, choosing block boundaries that
+//  don't split a quantum (encoding: whole lines, decoding: whole quanta or whole lines).  The
+//  worker threads claim the filled slots in sequence and convert them into the slot's output
+//  buffer, and the calling thread writes the converted slots out in sequence before handing
+//  them back to the reader.  Output order therefore never depends on which worker finished first.
+//
+
+/**
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "MIGPipeline.h"
+
+#define MIG_PIPELINE_DEFAULT_BUFFER     (256 * 1024)
+#define MIG_PIPELINE_MINIMUM_BUFFER     128         /* Room for at least one formatted line */
+#define MIG_PIPELINE_HELD               2           /* Decoded bytes held back until the stream's padding is known */
+
+typedef enum eMIG_SlotState
+{
+    MIG_SlotFree = 0,               /* Waiting for the reader */
+    MIG_SlotRead,                   /* Filled, waiting for a worker */
+    MIG_SlotConverted,              /* Converted, waiting for the writer */
+} MIG_SlotState;
+
+typedef struct sMIG_PipelineSlot
+{
+    MIG_SlotState state;
+    unsigned long long seq;         /* Position of the block in the stream */
+    char *in;
+    unsigned int inLen;
+    char *out;                      /* Decoding: preceded by room for the bytes held back from the previous block */
+    unsigned int outLen;
+} MIG_PipelineSlot;
+
+typedef struct sMIG_Pipeline
+{
+    int in_fd;
+    int out_fd;
+    MIG_PipelineOptions options;
+    unsigned int blockSize;         /* Input capacity of a slot */
+    unsigned int outSize;           /* Output capacity of a slot */
+
+    MIG_PipelineSlot *slots;
+    unsigned int depth;
+    char *carry;                    /* Reader only: the input held over for the next block */
+    unsigned int pad;               /* Reader only until eof: the '=' padding at the end of the input read so far */
+
+    pthread_mutex_t lock;           /* Guards everything below, and the slot states */
+    pthread_cond_t filled;          /* A slot was filled, or reading finished */
+    pthread_cond_t converted;       /* A slot was converted, or reading finished */
+    pthread_cond_t freed;           /* A slot was written out */
+    unsigned long long readCnt;     /* Blocks filled by the reader */
+    unsigned long long claimCnt;    /* Blocks claimed by the workers */
+    int eof;
+    MIG_Result result;
+    int error;
+
+    unsigned long long bytesRead;   /* Reader only */
+    unsigned long long bytesWritten;/* Writer only */
+} MIG_Pipeline;
+
+#pragma mark -
+#pragma mark Helpers
+
+static double MIG_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Reads until 'len' bytes have arrived or end of file.  Returns the bytes read, or -1 on error */
+static ssize_t MIG_readFully(int fd, char *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = read(fd, buf + got, len - got);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0)
+            break;
+        got += n;
+    }
+    return got;
+}
+
+/* Writes all 'len' bytes.  Returns 0, or -1 on error */
+static int MIG_writeFully(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* Records the first failure and wakes every thread so they can wind down.  Lock must be held */
+static void MIG_pipelineFail(MIG_Pipeline *p, MIG_Result result, int error)
+{
+    if (p->result == MIG_OK)
+    {
+        p->result = result;
+        p->error = error;
+    }
+    pthread_cond_broadcast(&p->filled);
+    pthread_cond_broadcast(&p->converted);
+    pthread_cond_broadcast(&p->freed);
+}
+
+/* Returns the length of the prefix of the 'len' chars in 'in' to decode now, and moves the rest to 'carry' */
+static unsigned int MIG_pipelineSplit(MIG_Pipeline *p, char *in, unsigned int len, unsigned int *carryLen)
+{
+    if (p->options.mode == MIG_PipelineDecode)
+    {
+        return MIG_decodableLength(in, len, p->carry, carryLen);
+    }
+
+    /* Fast decoding needs whole lines (or, without line separators, whole quanta) */
+    unsigned int use = len;
+    while (use > 0 && in[use - 1] != '\n')
+        use--;
+    if (use == 0)
+        use = len & ~3u;
+
+    *carryLen = len - use;
+    memcpy(p->carry, in + use, *carryLen);
+    return use;
+}
+
+static MIG_Result MIG_pipelineConvert(MIG_Pipeline *p, MIG_PipelineSlot *slot)
+{
+    MIG_Result res;
+    unsigned int len = 0;
+
+    switch (p->options.mode)
+    {
+        case MIG_PipelineEncode:
+        {
+            /* Every block but the last is a whole number of lines, so the line separator between
+               blocks is added here */
+            unsigned int prefix = 0;
+            if (p->options.useOptionalLineEndings && slot->seq > 0)
+            {
+                slot->out[0] = '\r';
+                slot->out[1] = '\n';
+                prefix = 2;
+            }
+            res = MIG_encodeAsBase64Into(p->options.useOptionalLineEndings, (const unsigned char *)slot->in,
+                                         slot->inLen, slot->out + prefix, p->outSize - prefix, &len);
+            len += prefix;
+            break;
+        }
+        case MIG_PipelineDecode:
+        {
+            /* Every quantum is decoded in full, so a '=' part way through the stream decodes as it would
+               in a single call.  Only the padding at the very end is trimmed, by the writer */
+            unsigned int legal = MIG_legalLength(slot->in, slot->inLen);
+            if (legal % 4 != 0)
+            {
+                res = MIG_Base64EncodingInvalid;
+                break;
+            }
+            len = legal / 4 * 3;
+            res = MIG_decodeAsBase64Into(slot->in, slot->inLen, (unsigned char *)slot->out, len);
+            break;
+        }
+        case MIG_PipelineDecodeFast:
+            res = MIG_decodeAsBase64FastInto(slot->in, slot->inLen, (unsigned char *)slot->out, p->outSize, &len);
+            break;
+        default:
+            res = MIG_Base64UnknownError;
+            break;
+    }
+
+    slot->outLen = len;
+    return res;
+}
+
+#pragma mark -
+#pragma mark Threads
+
+static void *MIG_pipelineReader(void *arg)
+{
+    MIG_Pipeline *p = (MIG_Pipeline *)arg;
+    unsigned int carryLen = 0;
+    int eof = 0;
+
+    while (!eof)
+    {
+        MIG_PipelineSlot *slot = &p->slots[p->readCnt % p->depth];
+
+        pthread_mutex_lock(&p->lock);
+        while (p->result == MIG_OK && slot->state != MIG_SlotFree)
+            pthread_cond_wait(&p->freed, &p->lock);
+        int failed = p->result != MIG_OK;
+        pthread_mutex_unlock(&p->lock);
+        if (failed)
+            break;
+
+        memcpy(slot->in, p->carry, carryLen);
+        ssize_t n = MIG_readFully(p->in_fd, slot->in + carryLen, p->blockSize - carryLen);
+        if (n < 0)
+        {
+            int error = errno;
+            pthread_mutex_lock(&p->lock);
+            MIG_pipelineFail(p, MIG_IOError, error);
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+
+        eof = (size_t)n < p->blockSize - carryLen;
+        if (p->options.mode == MIG_PipelineDecode)
+        {
+            MIG_trackPadding(slot->in + carryLen, (unsigned int)n, p->bytesRead == 0, &p->pad);
+        }
+        p->bytesRead += n;
+
+        unsigned int len = carryLen + (unsigned int)n;
+        carryLen = 0;
+        if (!eof && p->options.mode != MIG_PipelineEncode)
+        {
+            len = MIG_pipelineSplit(p, slot->in, len, &carryLen);
+        }
+
+        /* Nothing to convert yet (or at all), so the slot can be refilled */
+        if (len == 0)
+            continue;
+
+        slot->inLen = len;
+        slot->seq = p->readCnt;
+
+        pthread_mutex_lock(&p->lock);
+        slot->state = MIG_SlotRead;
+        p->readCnt++;
+        pthread_cond_signal(&p->filled);
+        pthread_mutex_unlock(&p->lock);
+    }
+
+    pthread_mutex_lock(&p->lock);
+    if (eof && p->pad > 2)
+    {
+        /* As MIG_decodedLength, at most two '=' at the end of the whole stream */
+        MIG_pipelineFail(p, MIG_Base64EncodingInvalid, 0);
+    }
+    p->eof = 1;
+    pthread_cond_broadcast(&p->filled);
+    pthread_cond_broadcast(&p->converted);
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static void *MIG_pipelineWorker(void *arg)
+{
+    MIG_Pipeline *p = (MIG_Pipeline *)arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&p->lock);
+        while (p->result == MIG_OK && p->claimCnt == p->readCnt && !p->eof)
+            pthread_cond_wait(&p->filled, &p->lock);
+        if (p->result != MIG_OK || p->claimCnt == p->readCnt)
+        {
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        MIG_PipelineSlot *slot = &p->slots[p->claimCnt++ % p->depth];
+        pthread_mutex_unlock(&p->lock);
+
+        MIG_Result res = MIG_pipelineConvert(p, slot);
+
+        pthread_mutex_lock(&p->lock);
+        if (res != MIG_OK)
+        {
+            MIG_pipelineFail(p, res, 0);
+        }
+        slot->state = MIG_SlotConverted;
+        pthread_cond_broadcast(&p->converted);
+        pthread_mutex_unlock(&p->lock);
+    }
+    return NULL;
+}
+
+/* Runs on the calling thread, writing the converted slots out in sequence */
+static void MIG_pipelineWriter(MIG_Pipeline *p, unsigned long long *blocks)
+{
+    /* Decoding: the last bytes written so far, held back until the padding at the end of the stream is known */
+    int holding = p->options.mode == MIG_PipelineDecode;
+    char held[MIG_PIPELINE_HELD];
+    unsigned int heldLen = 0;
+
+    for (unsigned long long w = 0;; w++)
+    {
+        MIG_PipelineSlot *slot = &p->slots[w % p->depth];
+
+        pthread_mutex_lock(&p->lock);
+        while (p->result == MIG_OK && !(w < p->readCnt && slot->state == MIG_SlotConverted) &&
+               !(p->eof && w == p->readCnt))
+        {
+            pthread_cond_wait(&p->converted, &p->lock);
+        }
+        int done = p->result != MIG_OK || w == p->readCnt;
+        int finished = p->result == MIG_OK && w == p->readCnt;
+        unsigned int pad = finished ? p->pad : 0;
+        pthread_mutex_unlock(&p->lock);
+
+        char *out;
+        unsigned int outLen;
+        if (done)
+        {
+            if (!finished || !holding)
+                break;
+
+            /* The end of the stream: everything held back but the padding */
+            out = held;
+            outLen = heldLen - (pad < heldLen ? pad : heldLen);
+        }
+        else
+        {
+            out = slot->out;
+            outLen = slot->outLen;
+        }
+
+        if (holding && !done)
+        {
+            /* Put the bytes held back in front of this block, and hold back its own last bytes */
+            out -= heldLen;
+            memcpy(out, held, heldLen);
+            outLen += heldLen;
+            heldLen = outLen < MIG_PIPELINE_HELD ? outLen : MIG_PIPELINE_HELD;
+            outLen -= heldLen;
+            memcpy(held, out + outLen, heldLen);
+        }
+
+        if (MIG_writeFully(p->out_fd, out, outLen) != 0)
+        {
+            int error = errno;
+            pthread_mutex_lock(&p->lock);
+            MIG_pipelineFail(p, MIG_IOError, error);
+            pthread_mutex_unlock(&p->lock);
+            break;
+        }
+        p->bytesWritten += outLen;
+        if (done)
+            break;
+        *blocks = w + 1;
+
+        pthread_mutex_lock(&p->lock);
+        slot->state = MIG_SlotFree;
+        pthread_cond_signal(&p->freed);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+#pragma mark -
+#pragma mark Pipeline
+
+void MIG_pipelineDefaultOptions(MIG_PipelineOptions *options)
+{
+    options->mode = MIG_PipelineEncode;
+    options->useOptionalLineEndings = 0;
+    options->bufferSize = MIG_PIPELINE_DEFAULT_BUFFER;
+    options->ringDepth = 0;
+    options->workerCount = 1;
+}
+
+MIG_Result MIG_pipeline(int in_fd,
+                        int out_fd,
+                        const MIG_PipelineOptions *options,
+                        MIG_PipelineStats *stats)
+{
+    double start = MIG_now();
+
+    MIG_Pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.in_fd = in_fd;
+    p.out_fd = out_fd;
+    if (options)
+        p.options = *options;
+    else
+        MIG_pipelineDefaultOptions(&p.options);
+
+    /* Fill in the defaults */
+    int formatted = p.options.mode == MIG_PipelineEncode && p.options.useOptionalLineEndings;
+    p.options.useOptionalLineEndings = formatted;
+    unsigned int workers = p.options.workerCount > 0 ? p.options.workerCount : 1;
+    p.depth = p.options.ringDepth > 0 ? p.options.ringDepth : workers + 2;
+    if (p.depth < 2)
+        p.depth = 2;
+    p.blockSize = p.options.bufferSize > 0 ? p.options.bufferSize : MIG_PIPELINE_DEFAULT_BUFFER;
+    if (p.blockSize < MIG_PIPELINE_MINIMUM_BUFFER)
+        p.blockSize = MIG_PIPELINE_MINIMUM_BUFFER;
+
+    if (p.options.mode == MIG_PipelineEncode)
+    {
+        /* Whole lines per block when formatting, whole quanta otherwise */
+        p.blockSize -= p.blockSize % (formatted ? 57 : 3);
+        p.outSize = MIG_encodedLength(formatted, p.blockSize) + 2;
+    }
+    else
+    {
+        p.outSize = p.blockSize / 4 * 3 + 3;
+    }
+
+    /* One allocation for the slots, and the input and output buffers they point into */
+    size_t slotBytes = (size_t)p.blockSize + MIG_PIPELINE_HELD + p.outSize;
+    char *storage = (char *)malloc(p.depth * (sizeof(MIG_PipelineSlot) + slotBytes) + p.blockSize);
+    pthread_t *threads = (pthread_t *)calloc(workers + 1, sizeof(pthread_t));
+    if (storage == NULL || threads == NULL)
+    {
+        free(storage);
+        free(threads);
+        return MIG_NoMemory;
+    }
+
+    p.slots = (MIG_PipelineSlot *)storage;
+    char *buffers = storage + p.depth * sizeof(MIG_PipelineSlot);
+    for (unsigned int i = 0; i < p.depth; i++)
+    {
+        p.slots[i].state = MIG_SlotFree;
+        p.slots[i].in = buffers + i * slotBytes;
+        p.slots[i].out = p.slots[i].in + p.blockSize + MIG_PIPELINE_HELD;
+    }
+    p.carry = buffers + p.depth * slotBytes;
+
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.filled, NULL);
+    pthread_cond_init(&p.converted, NULL);
+    pthread_cond_init(&p.freed, NULL);
+
+    /* Reader and workers on their own threads, the writer on this one */
+    unsigned int started = 0;
+    int err = pthread_create(&threads[started], NULL, MIG_pipelineReader, &p);
+    if (err == 0)
+    {
+        started++;
+        for (unsigned int i = 0; err == 0 && i < workers; i++)
+        {
+            err = pthread_create(&threads[started], NULL, MIG_pipelineWorker, &p);
+            if (err == 0)
+                started++;
+        }
+    }
+
+    unsigned long long blocks = 0;
+    if (err == 0)
+    {
+        MIG_pipelineWriter(&p, &blocks);
+    }
+    else
+    {
+        pthread_mutex_lock(&p.lock);
+        MIG_pipelineFail(&p, started > 0 ? MIG_Base64UnknownError : MIG_NoMemory, err);
+        pthread_mutex_unlock(&p.lock);
+    }
+
+    for (unsigned int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&p.freed);
+    pthread_cond_destroy(&p.converted);
+    pthread_cond_destroy(&p.filled);
+    pthread_mutex_destroy(&p.lock);
+    free(threads);
+    free(storage);
+
+    if (stats)
+    {
+        stats->bytesRead = p.bytesRead;
+        stats->bytesWritten = p.bytesWritten;
+        stats->blocks = blocks;
+        stats->seconds = MIG_now() - start;
+        stats->throughput = stats->seconds > 0 ? p.bytesRead / stats->seconds : 0;
+        stats->error = p.error;
+    }
+
+    return p.result;
+}
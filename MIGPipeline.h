@@ -0,0 +1,97 @@
+//
+//  MIGPipeline.h
+//  Base64_Tests
+//
+//  Streams a file descriptor through the MIGConverter routines into another file descriptor.
+//  Reading, conversion and writing overlap: a reader thread fills a small ring of buffers,
+//  one or more worker threads encode or decode them, and the calling thread writes the
+//  results out in their original order.
+//
+
+/**
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice, this list
+ * of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice, this
+ * list of conditions and the following disclaimer in the documentation and/or other
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+ * OF SUCH DAMAGE.
+ */
+
+#ifndef MIGPipeline_h
+#define MIGPipeline_h
+
+#include "MIGConverter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum eMIG_PipelineMode
+{
+    MIG_PipelineEncode = 0,             /* Encode the input as Base64 */
+    MIG_PipelineDecode = 1,             /* Decode, ignoring illegal characters (as MIG_decodeAsBase64) */
+    MIG_PipelineDecodeFast = 2,         /* Decode input meeting the preconditions of MIG_decodeAsBase64Fast */
+} MIG_PipelineMode;
+
+typedef struct sMIG_PipelineOptions
+{
+    MIG_PipelineMode mode;
+    int useOptionalLineEndings;         /* Encoding only.  0 == unformated, all else == formatted */
+    unsigned int bufferSize;            /* Input bytes per block.  0 == default (256KB) */
+    unsigned int ringDepth;             /* Blocks in flight.  0 == default (workerCount + 2) */
+    unsigned int workerCount;           /* Conversion threads.  0 == default (1) */
+} MIG_PipelineOptions;
+
+typedef struct sMIG_PipelineStats
+{
+    unsigned long long bytesRead;
+    unsigned long long bytesWritten;
+    unsigned long long blocks;          /* Blocks converted */
+    double seconds;                     /* Wall clock time of the whole run */
+    double throughput;                  /* Input bytes per second */
+    int error;                          /* errno of the failure when MIG_IOError is returned */
+} MIG_PipelineStats;
+
+/**
+    Fills 'options' with the defaults: encode, unformatted, 256KB blocks, one worker.
+*/
+void MIG_pipelineDefaultOptions(MIG_PipelineOptions *options);
+
+/**
+    Reads 'in_fd' until end of file, encoding or decoding it into 'out_fd'.
+    Block boundaries are chosen so that the output is identical to that of a single call to
+    MIG_encodeAsBase64, MIG_decodeAsBase64 or MIG_decodeAsBase64Fast over the whole input.
+    When decoding, '=' padding is only trimmed from the end of the whole stream, so a '=' part way
+    through decodes as it would in a single call (see MIG_trackPadding).
+    With more than one worker, blocks are converted concurrently but written in order.
+    Neither descriptor is closed.
+    Parameters :-
+      in_fd: the descriptor to read from
+      out_fd: the descriptor to write to
+      options: the pipeline configuration.  NULL uses MIG_pipelineDefaultOptions
+      stats: if not NULL, receives the bytes transferred, elapsed time and throughput
+    Returns :-
+      The status of the call (see eMIG_Result enum).  On failure some output may have been written.
+*/
+MIG_Result MIG_pipeline(int in_fd,
+                        int out_fd,
+                        const MIG_PipelineOptions *options,
+                        MIG_PipelineStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -61,6 +61,17 @@
  If an error occurs, returns nil.  Use the error object to determine the failure. */
 - (NSData *)decodeFromBase64Data:(NSError **)error;
 
+/** Strictly decodes from the passed in chars, and returns a new NSData object on success.
+ Only the Base64 alphabet, '=' padding and line separators are accepted.  Decoding stops at the
+ first offending character without allocating the result; the error's userInfo holds its byte
+ offset under kB64ErrorOffsetKey */
++ (NSData *)dataFromBase64EncodedCharsStrict:(const char *)data
+                                      length:(int)length
+                                       error:(NSError **)error;
+
+/** Strictly decodes the object's Base64 content (see dataFromBase64EncodedCharsStrict) */
+- (NSData *)decodeFromBase64DataStrict:(NSError **)error;
+
 #pragma mark Encoders
 
 /** Creates an NSString object containing the base64 encoding of 'data' using line formatting
@@ -80,6 +91,38 @@
 - (NSString *)encodeAsBase64StringUsingLineEndings:(BOOL)useOptionalLineEndings
                                              error:(NSError **)error;
 
+#pragma mark Appending to existing buffers
+
+/** Appends the base64 encoding of 'bytes' to 'data', growing 'data' once to the exact size
+ required and encoding straight into its tail (no intermediate buffer is allocated).
+ Appending 0 bytes succeeds without changing 'data', even if 'bytes' is NULL.
+ Returns NO on failure, leaving 'data' unchanged.  Use the error object to determine the failure */
++ (BOOL)appendBase64EncodingOfBytes:(const void *)bytes
+                             length:(NSUInteger)length
+                         formatting:(BOOL)useOptionalLineEndings
+                             toData:(NSMutableData *)data
+                              error:(NSError **)error;
+
+/** Appends the base64 encoding of 'source' to 'data' (see appendBase64EncodingOfBytes) */
++ (BOOL)appendBase64EncodingOfData:(NSData *)source
+                        formatting:(BOOL)useOptionalLineEndings
+                            toData:(NSMutableData *)data
+                             error:(NSError **)error;
+
+/** Appends the decoding of the base64 'chars' to 'data', growing 'data' once to the exact size
+ required and decoding straight into its tail (no intermediate buffer is allocated).
+ Appending 0 chars succeeds without changing 'data', even if 'chars' is NULL.
+ Returns NO on failure, leaving 'data' unchanged.  Use the error object to determine the failure */
++ (BOOL)appendBase64DecodingOfChars:(const char *)chars
+                             length:(NSUInteger)length
+                             toData:(NSMutableData *)data
+                              error:(NSError **)error;
+
+/** Appends the decoding of the base64 content of 'source' to 'data' (see appendBase64DecodingOfChars) */
++ (BOOL)appendBase64DecodingOfData:(NSData *)source
+                            toData:(NSMutableData *)data
+                             error:(NSError **)error;
+
 @end
 
 
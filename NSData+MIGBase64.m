@@ -34,6 +34,7 @@
 #import "MIGConverter.h"
 #import "MIGBase64_Common.h"
 #import "NSString+MIGBase64.h"
+#import "MIGBase64Cache.h"
 
 #if !__has_feature(objc_arc)
 #error MIGBase64+categories must be built with ARC.
@@ -76,6 +77,31 @@
     return [NSData dataFromBase64EncodedChars:self.bytes length:self.length error:error];
 }
 
++ (NSData *)dataFromBase64EncodedCharsStrict:(const char *)data
+                                      length:(int)length
+                                       error:(NSError **)error
+{
+    unsigned char *result;
+    unsigned int result_len;
+    MIG_ErrorDetail detail;
+    MIG_Result res = MIG_decodeAsBase64Strict(data, length, &result, &result_len, &detail);
+    if (res == MIG_OK)
+    {
+        return [[NSData alloc] initWithBytesNoCopy:result
+                                            length:result_len
+                                      freeWhenDone:YES];
+    }
+    
+    // Got an error -- generate a descriptive error, including where it happened
+    *error = generateErrorStructureWithDetail(detail);
+    return nil;
+}
+
+- (NSData *)decodeFromBase64DataStrict:(NSError **)error
+{
+    return [NSData dataFromBase64EncodedCharsStrict:self.bytes length:self.length error:error];
+}
+
 #pragma mark Encoders
 
 + (NSString *)stringByEncodingDataAsBase64:(NSData *)data
@@ -91,14 +117,27 @@
     char *result;
     unsigned int result_len;
     
+    // Repeatedly encoded payloads can be served from the (opt-in) result cache
+    MIGBase64Cache *cache = [MIGBase64Cache sharedCache];
+    BOOL cacheable = [cache shouldCacheLength:self.length];
+    if (cacheable)
+    {
+        NSData *cached = [cache encodedDataForData:self formatting:useOptionalLineEndings];
+        if (cached)
+            return cached;
+    }
+    
     MIG_Result res = MIG_encodeAsBase64(useOptionalLineEndings==YES?1:0,
                                         (const unsigned char *)(self.bytes), self.length,
                                         &result, &result_len);
     if (res == MIG_OK)
     {
-        return [[NSData alloc] initWithBytesNoCopy:result
-                                            length:result_len
-                                      freeWhenDone:YES];
+        NSData *encoded = [[NSData alloc] initWithBytesNoCopy:result
+                                                       length:result_len
+                                                 freeWhenDone:YES];
+        if (cacheable)
+            [cache setEncodedData:encoded forData:self formatting:useOptionalLineEndings];
+        return encoded;
     }
     
     // Got an error -- generate a descriptive error
@@ -111,16 +150,30 @@
 {
     char *result;
     unsigned int result_len;
+    
+    // Repeatedly encoded payloads can be served from the (opt-in) result cache
+    MIGBase64Cache *cache = [MIGBase64Cache sharedCache];
+    BOOL cacheable = [cache shouldCacheLength:self.length];
+    if (cacheable)
+    {
+        NSString *cached = [cache encodedStringForData:self formatting:useOptionalLineEndings];
+        if (cached)
+            return cached;
+    }
+    
     MIG_Result res = MIG_encodeAsBase64(useOptionalLineEndings==YES?1:0,
                                         (const unsigned char *)(self.bytes), self.length,
                                         &result, &result_len);
     if (res == MIG_OK)
     {
         // Assumption here is that the result is an ASCII formatted string containing the Base64 encoding.
-        return [[NSString alloc] initWithBytesNoCopy:result
-                                              length:result_len
-                                            encoding:NSASCIIStringEncoding
-                                        freeWhenDone:YES];
+        NSString *encoded = [[NSString alloc] initWithBytesNoCopy:result
+                                                           length:result_len
+                                                         encoding:NSASCIIStringEncoding
+                                                     freeWhenDone:YES];
+        if (cacheable)
+            [cache setEncodedString:encoded forData:self formatting:useOptionalLineEndings];
+        return encoded;
     }
     
     // Got an error -- generate a descriptive error
@@ -128,6 +181,99 @@
     return nil;
 }
 
+#pragma mark Appending to existing buffers
+
++ (BOOL)appendBase64EncodingOfBytes:(const void *)bytes
+                             length:(NSUInteger)length
+                         formatting:(BOOL)useOptionalLineEndings
+                             toData:(NSMutableData *)data
+                              error:(NSError **)error
+{
+    // Nothing to append (-[NSData bytes] may be NULL for empty data)
+    if (length == 0)
+    {
+        return YES;
+    }
+    
+    MIG_Result res = MIG_InputDataEmpty;
+    if (bytes != NULL)
+    {
+        unsigned int result_len = MIG_encodedLength(useOptionalLineEndings==YES?1:0, (unsigned int)length);
+        NSUInteger offset = data.length;
+        
+        // Grow once, to the exact size, and encode straight into the tail
+        [data increaseLengthBy:result_len];
+        res = MIG_encodeAsBase64Into(useOptionalLineEndings==YES?1:0,
+                                     (const unsigned char *)bytes, (unsigned int)length,
+                                     (char *)data.mutableBytes + offset, result_len,
+                                     &result_len);
+        if (res == MIG_OK)
+        {
+            return YES;
+        }
+        [data setLength:offset];
+    }
+    
+    // Got an error -- generate a descriptive error
+    *error = generateErrorStructure(res);
+    return NO;
+}
+
++ (BOOL)appendBase64EncodingOfData:(NSData *)source
+                        formatting:(BOOL)useOptionalLineEndings
+                            toData:(NSMutableData *)data
+                             error:(NSError **)error
+{
+    return [NSData appendBase64EncodingOfBytes:source.bytes
+                                        length:source.length
+                                    formatting:useOptionalLineEndings
+                                        toData:data
+                                         error:error];
+}
+
++ (BOOL)appendBase64DecodingOfChars:(const char *)chars
+                             length:(NSUInteger)length
+                             toData:(NSMutableData *)data
+                              error:(NSError **)error
+{
+    // Nothing to append, as with an empty string for MIG_decodeAsBase64
+    if (length == 0)
+    {
+        return YES;
+    }
+    
+    unsigned int result_len;
+    MIG_Result res = MIG_decodedLength(chars, (unsigned int)length, &result_len);
+    if (res == MIG_OK)
+    {
+        NSUInteger offset = data.length;
+        
+        // Grow once, to the exact size, and decode straight into the tail
+        [data increaseLengthBy:result_len];
+        res = MIG_decodeAsBase64Into(chars, (unsigned int)length,
+                                     (unsigned char *)data.mutableBytes + offset, result_len);
+        if (res == MIG_OK)
+        {
+            return YES;
+        }
+        [data setLength:offset];
+    }
+    
+    // Got an error -- generate a descriptive error
+    *error = generateErrorStructure(res);
+    return NO;
+}
+
++ (BOOL)appendBase64DecodingOfData:(NSData *)source
+                            toData:(NSMutableData *)data
+                             error:(NSError **)error
+{
+    return [NSData appendBase64DecodingOfChars:source.bytes
+                                        length:source.length
+                                        toData:data
+                                         error:error];
+}
+
 @end
 
 